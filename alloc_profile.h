@@ -0,0 +1,475 @@
+/**
+ * \brief Cellcrypt allocation profiler
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Heap allocation profile of a whole program, by phase.
+ *
+ * Built with -DCELLCRYPT_ALLOC_PROFILE, this header replaces the global
+ * operator new and delete, aligned forms included (alignas(64) nodes use
+ * them), so it must be included by exactly one translation unit of a program
+ * (its main file), never by a library. Every allocation is counted in the
+ * current phase (SetAllocPhase()): number, bytes, peak bytes in use and a
+ * histogram of sizes by power of two; the report's own allocations are not.
+ * One allocation in kAllocSampleEvery (CELLCRYPT_ALLOC_SAMPLE overrides it)
+ * also records its call stack, so PrintAllocProfile() can list the call sites
+ * allocating the most in each phase.
+ *
+ * Call sites are named by dladdr(): build with -g -rdynamic for function
+ * names; otherwise module+offset pairs go to addr2line -f -C -e <module>.
+ *
+ * The hooks never allocate: counters are atomics and samples go to fixed
+ * tables. Without the macro SetAllocPhase() and PrintAllocProfile() do
+ * nothing.
+ */
+
+#ifndef ALLOC_PROFILE_H_
+#define ALLOC_PROFILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#if defined(CELLCRYPT_ALLOC_PROFILE)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <unwind.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <new>
+#include <string>
+#include <vector>
+
+//! Phases told apart; later ones share the last
+constexpr uint32_t kAllocPhasesMax = 16;
+//! Phase of PrintAllocProfile() itself, past the others and never listed
+constexpr uint32_t kAllocReportPhase = kAllocPhasesMax;
+//! Size histogram buckets: bucket b holds sizes up to 2^b bytes
+constexpr uint32_t kAllocBuckets = 48;
+//! Distinct (phase, call stack) pairs kept
+constexpr uint32_t kAllocSitesMax = 4096;
+//! Frames kept of a call stack
+constexpr uint32_t kAllocSiteDepth = 4;
+//! Default sampling: one allocation in this many records its call stack
+constexpr uint32_t kAllocSampleEvery = 8;
+//! Call sites listed per phase
+constexpr uint32_t kAllocTopSites = 10;
+
+/**
+ * \brief Counters of one phase
+ */
+struct AllocPhaseCounters {
+  std::atomic<const char *> name{nullptr};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> frees{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> peak_bytes{0};  //!< Most bytes in use in the phase
+  std::atomic<uint64_t> buckets[kAllocBuckets] = {};
+};
+
+/**
+ * \brief Sampled call site
+ */
+struct AllocSite {
+  std::atomic<uint64_t> key{0};  //!< Hash of phase and frames; 0 if free
+  uint32_t phase;
+  uintptr_t frames[kAllocSiteDepth];
+  std::atomic<uint64_t> samples{0};
+  std::atomic<uint64_t> bytes{0};
+};
+
+/**
+ * \brief Profiler state (zero initialized, usable before any constructor)
+ */
+struct AllocProfile {
+  std::atomic<uint32_t> phase{0};
+  std::atomic<uint32_t> num_phases{1};
+  std::atomic<uint64_t> current_bytes{0};
+  std::atomic<uint64_t> sequence{0};
+  std::atomic<uint64_t> dropped{0};  //!< Samples not kept: site table full
+  AllocPhaseCounters phases[kAllocPhasesMax + 1];
+  AllocSite sites[kAllocSitesMax];
+};
+
+inline AllocProfile g_alloc_profile;
+
+//! Bytes before every block, to know its size on free (keeps 16 alignment);
+//! blocks aligned to more have a header of their alignment, size at its end
+constexpr size_t kAllocHeader = 16;
+
+/**
+ * \brief Get sampling period (read once from CELLCRYPT_ALLOC_SAMPLE)
+ */
+inline uint64_t AllocSampleEvery() {
+  static const uint64_t every = [] {
+    const char *env = std::getenv("CELLCRYPT_ALLOC_SAMPLE");
+    const uint64_t v = env != nullptr ? std::strtoull(env, nullptr, 10) : 0;
+    return v > 0 ? v : kAllocSampleEvery;
+  }();
+  return every;
+}
+
+/**
+ * \brief Call stack being collected by _Unwind_Backtrace()
+ */
+struct AllocUnwind {
+  uintptr_t frames[kAllocSiteDepth];
+  uint32_t skip;   //!< Profiler frames still to skip
+  uint32_t depth;  //!< Frames collected
+};
+
+inline _Unwind_Reason_Code AllocUnwindFrame(_Unwind_Context *ctx, void *arg) {
+  AllocUnwind *u = static_cast<AllocUnwind *>(arg);
+  if (u->skip > 0) {
+    --u->skip;
+    return _URC_NO_REASON;
+  }
+  u->frames[u->depth++] = static_cast<uintptr_t>(_Unwind_GetIP(ctx));
+
+  return u->depth == kAllocSiteDepth ? _URC_END_OF_STACK : _URC_NO_REASON;
+}
+
+/**
+ * \brief Record the call stack of an allocation
+ *
+ * Skipped frames: this one, AllocNew() and operator new (none inlined).
+ */
+__attribute__((noinline)) inline void AllocSample(uint32_t phase,
+                                                  uint64_t bytes) {
+  AllocUnwind u{{}, 3, 0};
+  _Unwind_Backtrace(AllocUnwindFrame, &u);
+
+  uint64_t key = 0xcbf29ce484222325u ^ phase;
+  for (uint32_t i = 0; i < u.depth; ++i) {
+    key = (key ^ u.frames[i]) * 0x100000001b3u;
+  }
+  key |= 1;  // 0 marks a free slot
+
+  AllocProfile &p = g_alloc_profile;
+  for (uint32_t probe = 0; probe < kAllocSitesMax; ++probe) {
+    AllocSite &s = p.sites[(key + probe) % kAllocSitesMax];
+    uint64_t cur = s.key.load(std::memory_order_acquire);
+    if (cur == 0) {
+      // claim the slot; frames are written before samples count it
+      if (s.key.compare_exchange_strong(cur, ~uint64_t(0))) {
+        s.phase = phase;
+        std::copy_n(u.frames, kAllocSiteDepth, s.frames);
+        std::fill(s.frames + u.depth, s.frames + kAllocSiteDepth, 0);
+        s.key.store(key, std::memory_order_release);
+        cur = key;
+      }
+    }
+    if (cur == key) {
+      s.samples.fetch_add(1, std::memory_order_relaxed);
+      s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+      return;
+    }
+  }
+  p.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Count an allocation and allocate
+ * \param size Bytes
+ * \param align Alignment (a power of two)
+ * \return Block; nullptr if out of memory
+ */
+__attribute__((noinline)) inline void *AllocNew(size_t size,
+                                                size_t align = kAllocHeader) {
+  const size_t header = std::max(align, kAllocHeader);
+  // aligned_alloc() takes a multiple of the alignment
+  const size_t total = (size + header + align - 1) & ~(align - 1);
+  void *raw = align <= kAllocHeader ? std::malloc(size + header)
+                                    : std::aligned_alloc(align, total);
+  if (raw == nullptr) {
+    return nullptr;
+  }
+  char *ptr = static_cast<char *>(raw) + header;
+  *reinterpret_cast<size_t *>(ptr - kAllocHeader) = size;
+
+  AllocProfile &p = g_alloc_profile;
+  const uint32_t phase = p.phase.load(std::memory_order_relaxed);
+  AllocPhaseCounters &c = p.phases[phase];
+  c.allocations.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(size, std::memory_order_relaxed);
+  const uint32_t bucket =
+      size <= 1 ? 0
+                : std::min<uint32_t>(64 - __builtin_clzll(size - 1),
+                                     kAllocBuckets - 1);
+  c.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+
+  const uint64_t in_use =
+      p.current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+  uint64_t peak = c.peak_bytes.load(std::memory_order_relaxed);
+  while (in_use > peak &&
+         !c.peak_bytes.compare_exchange_weak(peak, in_use,
+                                             std::memory_order_relaxed)) {
+  }
+
+  if (p.sequence.fetch_add(1, std::memory_order_relaxed) %
+          AllocSampleEvery() ==
+      0) {
+    AllocSample(phase, size);
+  }
+
+  return ptr;
+}
+
+/**
+ * \brief Count a free and free
+ * \param ptr Block from AllocNew() (or nullptr)
+ * \param align Alignment it was allocated with
+ */
+__attribute__((noinline)) inline void AllocDelete(void *ptr,
+                                                  size_t align = kAllocHeader) {
+  if (ptr == nullptr) {
+    return;
+  }
+  char *block = static_cast<char *>(ptr);
+  AllocProfile &p = g_alloc_profile;
+  p.current_bytes.fetch_sub(*reinterpret_cast<size_t *>(block - kAllocHeader),
+                            std::memory_order_relaxed);
+  p.phases[p.phase.load(std::memory_order_relaxed)].frees.fetch_add(
+      1, std::memory_order_relaxed);
+  std::free(block - std::max(align, kAllocHeader));
+}
+
+__attribute__((noinline)) void *operator new(size_t size) {
+  void *ptr = AllocNew(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size) {
+  void *ptr = AllocNew(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void *operator new(size_t size,
+                                             const std::nothrow_t &) noexcept {
+  return AllocNew(size);
+}
+
+__attribute__((noinline)) void *operator new[](
+    size_t size, const std::nothrow_t &) noexcept {
+  return AllocNew(size);
+}
+
+void operator delete(void *ptr) noexcept { AllocDelete(ptr); }
+void operator delete[](void *ptr) noexcept { AllocDelete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { AllocDelete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { AllocDelete(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  AllocDelete(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  AllocDelete(ptr);
+}
+
+__attribute__((noinline)) void *operator new(size_t size,
+                                             std::align_val_t align) {
+  void *ptr = AllocNew(size, static_cast<size_t>(align));
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void *operator new[](size_t size,
+                                               std::align_val_t align) {
+  void *ptr = AllocNew(size, static_cast<size_t>(align));
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+__attribute__((noinline)) void *operator new(size_t size,
+                                             std::align_val_t align,
+                                             const std::nothrow_t &) noexcept {
+  return AllocNew(size, static_cast<size_t>(align));
+}
+
+__attribute__((noinline)) void *operator new[](
+    size_t size, std::align_val_t align, const std::nothrow_t &) noexcept {
+  return AllocNew(size, static_cast<size_t>(align));
+}
+
+void operator delete(void *ptr, std::align_val_t align) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+void operator delete[](void *ptr, std::align_val_t align) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+void operator delete(void *ptr, size_t, std::align_val_t align) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+void operator delete[](void *ptr, size_t, std::align_val_t align) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+void operator delete(void *ptr, std::align_val_t align,
+                     const std::nothrow_t &) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+void operator delete[](void *ptr, std::align_val_t align,
+                       const std::nothrow_t &) noexcept {
+  AllocDelete(ptr, static_cast<size_t>(align));
+}
+
+/**
+ * \brief Count following allocations in a phase
+ *
+ * Allocations before the first call go to a "(start)" phase. Peak bytes of
+ * the phase start from bytes in use now. Called from one thread only.
+ *
+ * \param name Phase name (string literal; phases of the same name add up)
+ */
+inline void SetAllocPhase(const char *name) {
+  AllocProfile &p = g_alloc_profile;
+  const uint32_t n = p.num_phases.load();
+  uint32_t phase = 1;
+  while (phase < n && std::strcmp(p.phases[phase].name.load(), name) != 0) {
+    ++phase;
+  }
+  if (phase == n) {
+    if (n < kAllocPhasesMax) {
+      p.phases[phase].name.store(name);
+      p.num_phases.store(n + 1);
+    } else {
+      phase = kAllocPhasesMax - 1;  // shares the last phase
+    }
+  }
+
+  uint64_t peak = p.phases[phase].peak_bytes.load();
+  const uint64_t in_use = p.current_bytes.load();
+  while (in_use > peak &&
+         !p.phases[phase].peak_bytes.compare_exchange_weak(peak, in_use)) {
+  }
+  p.phase.store(phase);
+}
+
+/**
+ * \brief Describe a code address
+ * \return Demangled function name, or module+0xoffset for addr2line
+ */
+inline std::string AllocFrameName(uintptr_t pc) {
+  // return address: look up the call instruction before it
+  const void *addr = reinterpret_cast<const void *>(pc - 1);
+  Dl_info info{};
+  if (dladdr(addr, &info) == 0) {
+    return "?";
+  }
+  if (info.dli_sname != nullptr) {
+    int status = 0;
+    char *name = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+    std::string s = status == 0 ? name : info.dli_sname;
+    std::free(name);
+    return s;
+  }
+
+  const char *module = info.dli_fname != nullptr ? info.dli_fname : "?";
+  const char *slash = std::strrchr(module, '/');
+  char offset[32];
+  std::snprintf(offset, sizeof(offset), "+0x%zx",
+                static_cast<size_t>(pc - 1 -
+                                    reinterpret_cast<uintptr_t>(info.dli_fbase)));
+
+  return std::string(slash != nullptr ? slash + 1 : module) + offset;
+}
+
+/**
+ * \brief Print allocations of every phase and their top call sites
+ * \param o Output stream
+ */
+inline void PrintAllocProfile(std::ostream &o) {
+  AllocProfile &p = g_alloc_profile;
+  const uint64_t every = AllocSampleEvery();
+  // the report's own allocations go to a phase of their own
+  const uint32_t phase_before = p.phase.exchange(kAllocReportPhase);
+
+  // copy samples first: formatting allocates
+  struct Site {
+    uint32_t phase;
+    uint64_t samples;
+    uint64_t bytes;
+    uintptr_t frames[kAllocSiteDepth];
+  };
+  std::vector<Site> sites;
+  sites.reserve(kAllocSitesMax);
+  for (const AllocSite &s : p.sites) {
+    const uint64_t key = s.key.load(std::memory_order_acquire);
+    if (key != 0 && key != ~uint64_t(0)) {
+      Site site{s.phase, s.samples.load(), s.bytes.load(), {}};
+      std::copy_n(s.frames, kAllocSiteDepth, site.frames);
+      sites.push_back(site);
+    }
+  }
+  std::sort(sites.begin(), sites.end(), [](const Site &a, const Site &b) {
+    return a.bytes != b.bytes ? a.bytes > b.bytes : a.samples > b.samples;
+  });
+
+  o << "allocation profile (1 in " << every << " allocations sampled";
+  if (p.dropped.load() > 0) {
+    o << ", " << p.dropped.load() << " samples dropped";
+  }
+  o << ")\n";
+
+  for (uint32_t phase = 0; phase < p.num_phases.load(); ++phase) {
+    const AllocPhaseCounters &c = p.phases[phase];
+    if (c.allocations.load() == 0 && c.frees.load() == 0) {
+      continue;
+    }
+    const char *name = c.name.load();
+    o << "\nphase " << (name != nullptr ? name : "(start)") << ": "
+      << c.allocations.load() << " allocations, " << c.frees.load()
+      << " frees, " << c.bytes.load() << " bytes, peak in use "
+      << c.peak_bytes.load() << " bytes\n";
+
+    o << "  size (bytes)   allocations\n";
+    for (uint32_t b = 0; b < kAllocBuckets; ++b) {
+      if (c.buckets[b].load() > 0) {
+        o << "  <= " << std::left << std::setw(12) << (uint64_t(1) << b)
+          << std::right << std::setw(10) << c.buckets[b].load() << '\n';
+      }
+    }
+
+    o << "  top call sites (estimated allocations, bytes):\n";
+    uint32_t listed = 0;
+    for (const Site &s : sites) {
+      if (s.phase != phase || listed == kAllocTopSites) {
+        continue;
+      }
+      ++listed;
+      o << "  " << std::setw(10) << s.samples * every << std::setw(14)
+        << s.bytes * every << "  ";
+      for (uint32_t i = 0; i < kAllocSiteDepth && s.frames[i] != 0; ++i) {
+        o << (i > 0 ? "\n                                <- " : "")
+          << AllocFrameName(s.frames[i]);
+      }
+      o << '\n';
+    }
+  }
+
+  p.phase.store(phase_before);
+}
+
+#else  // !defined(CELLCRYPT_ALLOC_PROFILE)
+
+inline void SetAllocPhase(const char *) {}
+inline void PrintAllocProfile(std::ostream &) {}
+
+#endif  // defined(CELLCRYPT_ALLOC_PROFILE)
+
+#endif  // ALLOC_PROFILE_H_
@@ -0,0 +1,760 @@
+/**
+ * \brief Cellcrypt big number
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef BIG_NUM_H_
+#define BIG_NUM_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "big_num_stats.h"
+#include "limb_radix.h"
+
+/**
+ * \brief Fixed capacity limb storage
+ *
+ * Same interface as the std::vector members BasicBigNum uses, on a std::array
+ * of MaxLimbs limbs: it never allocates. Growing past MaxLimbs is a bug
+ * (asserted); size the capacity with a bound like FactorialLimbsBound().
+ *
+ * Products of two numbers of kKaratsubaThreshold limbs or more take scratch
+ * from a per thread buffer, allocated once.
+ */
+template <size_t MaxLimbs, typename Limb = uint64_t>
+class FixedLimbs {
+ public:
+  /**
+   * \brief Default constructor
+   */
+  FixedLimbs() : size_(0) {}
+
+  /**
+   * \brief Copy constructor (copies used limbs only)
+   */
+  FixedLimbs(const FixedLimbs &other) : size_(other.size_) {
+    std::copy_n(other.limbs_.data(), size_, limbs_.data());
+  }
+
+  /**
+   * \brief Copy assignment (copies used limbs only)
+   */
+  FixedLimbs &operator=(const FixedLimbs &other) {
+    size_ = other.size_;
+    std::copy_n(other.limbs_.data(), size_, limbs_.data());
+
+    return *this;
+  }
+
+  static constexpr size_t capacity() { return MaxLimbs; }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  Limb *data() { return limbs_.data(); }
+  const Limb *data() const { return limbs_.data(); }
+  Limb &operator[](size_t i) { return limbs_[i]; }
+  Limb operator[](size_t i) const { return limbs_[i]; }
+  Limb back() const { return limbs_[size_ - 1]; }
+
+  /**
+   * \brief Set number of limbs; new limbs are zero
+   */
+  void resize(size_t limbs) {
+    assert(limbs <= MaxLimbs);
+    if (limbs > size_) {
+      std::fill(limbs_.data() + size_, limbs_.data() + limbs, 0);
+    }
+    size_ = limbs;
+  }
+
+  void reserve(size_t limbs) const {
+    assert(limbs <= MaxLimbs);
+    (void)limbs;
+  }
+
+  void clear() { size_ = 0; }
+
+  void push_back(Limb limb) {
+    assert(size_ < MaxLimbs);
+    limbs_[size_++] = limb;
+  }
+
+  void pop_back() { --size_; }
+
+ private:
+  std::array<Limb, MaxLimbs> limbs_;  //!< Limbs (used up to size_)
+  size_t size_;                       //!< Number of limbs used
+};
+
+/**
+ * \brief Big number class
+ *
+ * Stores the number as limbs of a radix (see limb_radix.h), least significant
+ * limb first, with no leading zero limbs. No limbs is zero.
+ *
+ * Every operator has an in-place form (+=, -=, *=, /=, ShiftLimbs*) and a form
+ * writing to an output number (Add, Sub, Mul, DivMod); both only allocate when
+ * the destination has not enough capacity (see Reserve()).
+ *
+ * Storage holds the limbs: std::vector for BigNum, FixedLimbs for FixedBigNum,
+ * which never touches the heap. Built with -DCELLCRYPT_STATS, the vector
+ * counts allocations and operations count limb products and carry runs (see
+ * big_num_stats.h).
+ */
+template <typename Radix, typename Storage = LimbVector<typename Radix::Limb>>
+class BasicBigNum {
+ public:
+  using Limb = typename Radix::Limb;  //!< Limb type
+  using Ops = LimbOps<Radix>;         //!< Limb operations
+
+  static constexpr typename Radix::Wide kBase = Radix::kBase;  //!< Limb base
+  static constexpr uint32_t kDigitsPerLimb =
+      Radix::kDigitsPerLimb;  //!< Decimal digits per limb
+
+  /**
+   * \brief Default constructor
+   */
+  BasicBigNum() : big_num_() {}
+
+  /**
+   * \brief Construct from number
+   * \param num Initial value
+   */
+  explicit BasicBigNum(uint64_t num) : big_num_() {
+    for (; num > 0; num = static_cast<uint64_t>(num / kBase)) {
+      big_num_.push_back(static_cast<Limb>(num % kBase));
+    }
+  }
+
+  /**
+   * \brief r = a + b (r may be a or b)
+   */
+  static void Add(const BasicBigNum &a, const BasicBigNum &b, BasicBigNum *r) {
+    const BasicBigNum &big = a.big_num_.size() >= b.big_num_.size() ? a : b;
+    const BasicBigNum &small = &big == &a ? b : a;
+    const size_t n = big.big_num_.size();
+    const size_t m = small.big_num_.size();
+
+    r->big_num_.resize(n);
+    Limb carry = Ops::Add(r->big_num_.data(), big.big_num_.data(),
+                          small.big_num_.data(), m);
+    if (carry) {
+      NoteCarry(big.big_num_.data() + m, n - m, kMaxLimb);
+    }
+    carry = Ops::AddCarry(r->big_num_.data() + m, big.big_num_.data() + m,
+                          n - m, carry);
+    if (carry) {
+      r->big_num_.push_back(carry);
+    }
+  }
+
+  /**
+   * \brief r = a - b (r may be a or b)
+   *
+   * Number has no sign: a must not be less than b.
+   */
+  static void Sub(const BasicBigNum &a, const BasicBigNum &b, BasicBigNum *r) {
+    assert(a.Compare(b) >= 0);
+    const size_t n = a.big_num_.size();
+    const size_t m = b.big_num_.size();
+
+    r->big_num_.resize(n);
+    const Limb borrow = Ops::Sub(r->big_num_.data(), a.big_num_.data(),
+                                 b.big_num_.data(), m);
+    if (borrow) {
+      NoteCarry(a.big_num_.data() + m, n - m, 0);
+    }
+    Ops::SubBorrow(r->big_num_.data() + m, a.big_num_.data() + m, n - m,
+                   borrow);
+    r->Trim();
+  }
+
+  /**
+   * \brief r = a * m (r may be a)
+   */
+  static void Mul(const BasicBigNum &a, uint64_t m, BasicBigNum *r) {
+    if (m == 0) {
+      r->big_num_.clear();
+      return;
+    }
+    if constexpr (sizeof(Limb) < sizeof(m)) {
+      if (m > static_cast<Limb>(~Limb(0))) {
+        // multiplier wider than a limb
+        BasicBigNum p;
+        Mul(a, BasicBigNum(m), &p);
+        *r = std::move(p);
+        return;
+      }
+    }
+
+    StatsLimbMuls(a.big_num_.size());
+    r->big_num_.resize(a.big_num_.size());
+    Limb carry = Ops::MulSmall(r->big_num_.data(), a.big_num_.data(),
+                               a.big_num_.size(), static_cast<Limb>(m));
+
+    while (carry) {
+      Limb lo = 0;
+      carry = RadixSplit<Radix>(carry, &lo);
+      r->big_num_.push_back(lo);
+    }
+  }
+
+  /**
+   * \brief Multiply by several words in one pass over the limbs
+   * \param words Words, each at most Ops::kMulWordMax
+   * \param k Number of words (1 to kMulWordsMax)
+   */
+  void MulWords(const uint64_t *words, size_t k) {
+    const size_t n = big_num_.size();
+    StatsLimbMuls(n * k);
+    big_num_.resize(n + 2 * k);
+    Ops::MulWords(big_num_.data(), big_num_.data(), n, words, k);
+    Trim();
+  }
+
+  /**
+   * \brief q = a / d (q may be a)
+   * \param d Divisor (must not be 0)
+   * \return Remainder
+   */
+  static uint64_t DivMod(const BasicBigNum &a, uint64_t d, BasicBigNum *q) {
+    assert(d != 0);
+    q->big_num_.resize(a.big_num_.size());
+    const uint64_t rem = Ops::DivSmall(q->big_num_.data(), a.big_num_.data(),
+                                       a.big_num_.size(), d);
+    q->Trim();
+
+    return rem;
+  }
+
+  BasicBigNum operator+(const BasicBigNum &other) const {
+    BasicBigNum new_big_num;
+    new_big_num.Reserve(std::max(big_num_.size(), other.big_num_.size()) + 1);
+    Add(*this, other, &new_big_num);
+
+    return new_big_num;
+  }
+
+  BasicBigNum &operator+=(const BasicBigNum &other) {
+    Add(*this, other, this);
+
+    return *this;
+  }
+
+  BasicBigNum &operator+=(uint64_t num) {
+    if (num >= kBase) {
+      return *this += BasicBigNum(num);
+    }
+
+    if (num == 0) {
+      return *this;
+    }
+    if (big_num_.empty()) {
+      big_num_.push_back(0);
+    }
+
+    Limb carry = 0;
+    big_num_[0] = Ops::AddLimb(big_num_[0], static_cast<Limb>(num), &carry);
+    if (carry) {
+      NoteCarry(big_num_.data() + 1, big_num_.size() - 1, kMaxLimb);
+    }
+    if (carry && Ops::AddCarry(big_num_.data() + 1, big_num_.data() + 1,
+                               big_num_.size() - 1, 1)) {
+      big_num_.push_back(1);
+    }
+
+    return *this;
+  }
+
+  BasicBigNum operator-(const BasicBigNum &other) const {
+    BasicBigNum new_big_num;
+    new_big_num.Reserve(big_num_.size());
+    Sub(*this, other, &new_big_num);
+
+    return new_big_num;
+  }
+
+  BasicBigNum &operator-=(const BasicBigNum &other) {
+    Sub(*this, other, this);
+
+    return *this;
+  }
+
+  /**
+   * \brief r = a * b (r must not be a or b)
+   *
+   * r needs room for a.num_limbs() + b.num_limbs() limbs.
+   */
+  static void Mul(const BasicBigNum &a, const BasicBigNum &b, BasicBigNum *r) {
+    assert(r != &a && r != &b);
+    if (a.IsZero() || b.IsZero()) {
+      r->big_num_.clear();
+      return;
+    }
+
+    const size_t n = a.big_num_.size();
+    const size_t m = b.big_num_.size();
+    StatsLimbMuls(static_cast<uint64_t>(n) * m);
+    r->big_num_.resize(n + m);
+    Ops::Mul(r->big_num_.data(), a.big_num_.data(), n, b.big_num_.data(), m);
+    r->Trim();
+  }
+
+  BasicBigNum operator*(const BasicBigNum &other) const {
+    BasicBigNum new_big_num;
+    Mul(*this, other, &new_big_num);
+
+    return new_big_num;
+  }
+
+  BasicBigNum &operator*=(const BasicBigNum &other) {
+    BasicBigNum new_big_num;
+    Mul(*this, other, &new_big_num);
+    big_num_ = std::move(new_big_num.big_num_);
+
+    return *this;
+  }
+
+  BasicBigNum operator*(uint64_t num) const {
+    BasicBigNum new_big_num;
+    new_big_num.Reserve(big_num_.size() + 2);
+    Mul(*this, num, &new_big_num);
+
+    return new_big_num;
+  }
+
+  BasicBigNum &operator*=(uint64_t num) {
+    Mul(*this, num, this);
+
+    return *this;
+  }
+
+  BasicBigNum operator/(uint64_t num) const {
+    BasicBigNum new_big_num;
+    new_big_num.Reserve(big_num_.size());
+    DivMod(*this, num, &new_big_num);
+
+    return new_big_num;
+  }
+
+  BasicBigNum &operator/=(uint64_t num) {
+    DivMod(*this, num, this);
+
+    return *this;
+  }
+
+  /**
+   * \brief Remainder of division by a number (no allocation)
+   * \param num Divisor (must not be 0)
+   * \return Remainder
+   */
+  uint64_t operator%(uint64_t num) const {
+    assert(num != 0);
+
+    return Ops::ModSmall(big_num_.data(), big_num_.size(), num);
+  }
+
+  /**
+   * \brief Multiply by base^limbs
+   * \param limbs Number of limbs
+   */
+  BasicBigNum &ShiftLimbsLeft(size_t limbs) {
+    if (!big_num_.empty() && limbs > 0) {
+      const size_t n = big_num_.size();
+      big_num_.resize(n + limbs);
+      Limb *d = big_num_.data();
+      std::copy_backward(d, d + n, d + n + limbs);
+      std::fill(d, d + limbs, 0);
+    }
+
+    return *this;
+  }
+
+  /**
+   * \brief Divide by base^limbs, dropping the remainder
+   * \param limbs Number of limbs
+   */
+  BasicBigNum &ShiftLimbsRight(size_t limbs) {
+    const size_t n = big_num_.size();
+    limbs = std::min(limbs, n);
+    Limb *d = big_num_.data();
+    std::copy(d + limbs, d + n, d);
+    big_num_.resize(n - limbs);
+
+    return *this;
+  }
+
+  /**
+   * \brief Compare with other number
+   * \return -1 if less than other; 0 if equal; 1 if greater than other
+   */
+  int32_t Compare(const BasicBigNum &other) const {
+    if (big_num_.size() != other.big_num_.size()) {
+      return big_num_.size() < other.big_num_.size() ? -1 : 1;
+    }
+
+    return Ops::Cmp(big_num_.data(), other.big_num_.data(), big_num_.size());
+  }
+
+  /**
+   * \brief Check if number is zero
+   * \return true if zero; false otherwise
+   */
+  bool IsZero() const { return big_num_.empty(); }
+
+  /**
+   * \brief Get the number of limbs
+   * \return Number of limbs (0 for zero)
+   */
+  size_t num_limbs() const { return big_num_.size(); }
+
+  /**
+   * \brief Get limbs for writing, to build a number with a limb kernel
+   *
+   * Must be followed by LimbsFinish() once limbs are written.
+   *
+   * \param limbs Number of limbs
+   * \return Pointer to limbs (old value is kept up to limbs)
+   */
+  Limb *LimbsWrite(size_t limbs) {
+    big_num_.resize(limbs);
+    return big_num_.data();
+  }
+
+  /**
+   * \brief Drop leading zero limbs left by LimbsWrite()
+   */
+  void LimbsFinish() { Trim(); }
+
+  /**
+   * \brief Reserve room so operations up to this many limbs do not allocate
+   * \param limbs Number of limbs
+   */
+  void Reserve(size_t limbs) { big_num_.reserve(limbs); }
+
+  /**
+   * \brief Get big number raw data
+   * \return Limbs (data(), size() and operator[] as std::vector)
+   */
+  const Storage &big_num_raw() const { return big_num_; }
+
+  /**
+   * \brief Get the number of decimal digits
+   * \return Number of decimal digits (1 for zero)
+   */
+  size_t num_digits() const {
+    if constexpr (!Radix::kDecimal) {
+      return ToDecimal().num_digits();
+    } else {
+      if (big_num_.empty()) {
+        return 1;
+      }
+
+      size_t digits = (big_num_.size() - 1) * kDigitsPerLimb;
+      for (Limb top = big_num_.back(); top > 0; top /= 10) {
+        ++digits;
+      }
+
+      return digits;
+    }
+  }
+
+  /**
+   * \brief Write decimal digits into a caller buffer (no terminating null)
+   * \param buf Output buffer
+   * \param buf_len Size of output buffer
+   * \return Number of chars written; 0 if buffer is too small
+   */
+  size_t ToChars(char *buf, size_t buf_len) const {
+    if constexpr (!Radix::kDecimal) {
+      return ToDecimal().ToChars(buf, buf_len);
+    } else {
+      const size_t digits = num_digits();
+      if (buf_len < digits) {
+        return 0;
+      }
+
+      // top limb is not padded; the others are kDigitsPerLimb digits each
+      const size_t lower_limbs = big_num_.empty() ? 0 : big_num_.size() - 1;
+      const size_t top_digits = digits - lower_limbs * kDigitsPerLimb;
+      Limb top = big_num_.empty() ? 0 : big_num_.back();
+      for (size_t i = top_digits; i-- > 0; top /= 10) {
+        buf[i] = static_cast<char>('0' + top % 10);
+      }
+
+      if (lower_limbs > 0) {
+        Ops::Format(buf + top_digits, big_num_.data(), lower_limbs);
+      }
+
+      return digits;
+    }
+  }
+
+  /**
+   * \brief Convert to base 10^19 (binary radix only)
+   *
+   * Quadratic: one division of the whole number per output limb.
+   *
+   * \return Same number in decimal radix
+   */
+  BasicBigNum<Radix10e19> ToDecimal() const {
+    static_assert(!Radix::kDecimal && sizeof(Limb) == sizeof(uint64_t),
+                  "conversion is from 2^64 radix");
+    constexpr uint64_t kDecBase = static_cast<uint64_t>(Radix10e19::kBase);
+
+    std::vector<uint64_t> a(big_num_.data(), big_num_.data() + big_num_.size());
+    std::vector<uint64_t> dec;
+    while (!a.empty()) {
+      uint64_t rem = 0;
+      for (size_t i = a.size(); i-- > 0;) {
+        a[i] = Div128ByConst<kDecBase>(rem, a[i], &rem);
+      }
+      dec.push_back(rem);
+      while (!a.empty() && a.back() == 0) {
+        a.pop_back();
+      }
+    }
+
+    BasicBigNum<Radix10e19> d;
+    std::copy(dec.begin(), dec.end(), d.LimbsWrite(dec.size()));
+    d.LimbsFinish();
+
+    return d;
+  }
+
+ private:
+  static constexpr Limb kMaxLimb = static_cast<Limb>(kBase - 1);  //!< base - 1
+
+  /**
+   * \brief Count a carry run (stats builds only)
+   *
+   * A carry into limbs equal to fill (base - 1 for a carry, 0 for a borrow)
+   * goes through all of them and stops at the next limb or a new top limb.
+   *
+   * \param d Limbs above the shorter operand, before the carry
+   * \param n Number of limbs
+   * \param fill Limb value the carry passes through
+   */
+  static void NoteCarry(const Limb *d, size_t n, Limb fill) {
+    if constexpr (kBigNumStats) {
+      size_t len = 0;
+      while (len < n && d[len] == fill) {
+        ++len;
+      }
+      StatsCarry(len + 1);
+    }
+  }
+
+  /**
+   * \brief Drop leading zero limbs
+   */
+  void Trim() {
+    while (!big_num_.empty() && big_num_.back() == 0) {
+      big_num_.pop_back();
+    }
+  }
+
+  Storage big_num_;  //!< Limbs, least significant first
+};
+
+/**
+ * \brief Heap allocated big number, any size
+ */
+using BigNum = BasicBigNum<Radix10e15>;
+
+/**
+ * \brief Big number of at most MaxLimbs limbs that never allocates
+ */
+template <size_t MaxLimbs, typename Radix = Radix10e15>
+using FixedBigNum =
+    BasicBigNum<Radix, FixedLimbs<MaxLimbs, typename Radix::Limb>>;
+
+template <typename Radix, typename Storage>
+inline bool operator==(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) == 0;
+}
+
+template <typename Radix, typename Storage>
+inline bool operator!=(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) != 0;
+}
+
+template <typename Radix, typename Storage>
+inline bool operator<(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) < 0;
+}
+
+template <typename Radix, typename Storage>
+inline bool operator<=(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) <= 0;
+}
+
+template <typename Radix, typename Storage>
+inline bool operator>(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) > 0;
+}
+
+template <typename Radix, typename Storage>
+inline bool operator>=(const BasicBigNum<Radix, Storage> &a,
+                       const BasicBigNum<Radix, Storage> &b) {
+  return a.Compare(b) >= 0;
+}
+
+/**
+ * \brief Stream output BigNum
+ * \return Stream output BigNum
+ */
+template <typename Radix, typename Storage>
+inline std::ostream &operator<<(std::ostream &o,
+                                const BasicBigNum<Radix, Storage> &big_num) {
+  if constexpr (!Radix::kDecimal) {
+    return o << big_num.ToDecimal();
+  } else {
+    std::vector<char> digits(big_num.num_digits());
+    big_num.ToChars(digits.data(), digits.size());
+
+    return o.write(digits.data(), digits.size());
+  }
+}
+
+/**
+ * \brief Upper bound of limbs of the factorial of a number
+ *
+ * num! < num^num, which has at most num * digits(num) decimal digits; a
+ * batch of BasicBigNum::MulWords() needs 2 * kMulWordsMax limbs of room.
+ *
+ * \param num Number
+ * \return Limbs enough for num! (to size a FixedBigNum)
+ */
+template <typename Radix = Radix10e15>
+constexpr size_t FactorialLimbsBound(uint64_t num) {
+  size_t digits = 1;
+  for (uint64_t n = num; n >= 10; n /= 10) {
+    ++digits;
+  }
+
+  return num * digits / Radix::kDigitsPerLimb + 1 + 2 * kMulWordsMax;
+}
+
+/**
+ * \brief Multiply by every number in [lo, hi]
+ *
+ * Factors are packed into words while the product fits, and words applied
+ * kMulWordsMax at a time: one pass over f per batch instead of per factor.
+ *
+ * \param f Number to multiply
+ * \param lo First factor (at least 1)
+ * \param hi Last factor
+ */
+template <typename Num>
+inline void mul_range(Num *f, uint64_t lo, uint64_t hi) {
+  using Ops = typename Num::Ops;
+  assert(lo > 0);
+
+  uint64_t words[kMulWordsMax];
+  size_t k = 0;
+  uint64_t word = 1;
+  for (uint64_t i = hi; i >= lo; --i) {
+    const uint64_t max =
+        i <= Ops::kMulWordFastMax ? Ops::kMulWordFastMax : Ops::kMulWordMax;
+    if (i > max) {
+      *f *= i;  // wider than a word
+      continue;
+    }
+    if (word > max / i) {
+      words[k++] = word;
+      word = 1;
+      if (k == kMulWordsMax) {
+        f->MulWords(words, k);
+        k = 0;
+      }
+    }
+    word *= i;
+  }
+  words[k++] = word;
+  f->MulWords(words, k);
+}
+
+/**
+ * \brief Calculates the factorial of a number
+ * \param num Number to calculate factorial
+ * \return Factorial of given number
+ */
+template <typename Num = BigNum>
+inline Num factorial(uint64_t num) {
+  Num f(1);
+  if (num > 1) {
+    mul_range(&f, 2, num);
+  }
+
+  return f;
+}
+
+//! Numbers below which range_product() multiplies one by one
+constexpr uint64_t kRangeProductLeaf = 64;
+
+/**
+ * \brief Product of every number in [lo, hi] by a balanced product tree
+ *
+ * Halves of about the same size are multiplied together, so the work goes to
+ * the fast BigNum by BigNum multiply rather than to n passes over the result.
+ *
+ * \param lo First factor (at least 1)
+ * \param hi Last factor
+ * \return Product (1 for an empty range)
+ */
+template <typename Num = BigNum>
+inline Num range_product(uint64_t lo, uint64_t hi) {
+  Num p(1);
+  if (hi < lo) {
+    return p;
+  }
+  if (hi - lo < kRangeProductLeaf) {
+    mul_range(&p, lo, hi);
+    return p;
+  }
+
+  const uint64_t mid = lo + (hi - lo) / 2;
+  Num::Mul(range_product<Num>(lo, mid), range_product<Num>(mid + 1, hi), &p);
+
+  return p;
+}
+
+/**
+ * \brief Factorial by a product tree (faster than factorial() for large num)
+ * \param num Number to calculate factorial
+ * \return Factorial of given number
+ */
+template <typename Num = BigNum>
+inline Num factorial_tree(uint64_t num) {
+  return range_product<Num>(1, num);
+}
+
+/**
+ * \brief Calculates the sum of digits of a number
+ * \param big_num Number to calculate the sum
+ * \return Sum of digits of given number
+ */
+template <typename Radix, typename Storage>
+inline uint64_t sum_of_digits(const BasicBigNum<Radix, Storage> &big_num) {
+  if constexpr (!Radix::kDecimal) {
+    return sum_of_digits(big_num.ToDecimal());
+  } else {
+    return LimbOps<Radix>::DigitSum(big_num.big_num_raw().data(),
+                                    big_num.big_num_raw().size());
+  }
+}
+
+#endif  // BIG_NUM_H_
@@ -0,0 +1,274 @@
+/**
+ * \brief Cellcrypt big number benchmark
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Times BigNum settings against each other on the same work:
+ *
+ * - radix: factorial (multiply by word), square of the factorial (schoolbook
+ *   multiply) and decimal output (digit sum and formatting) for every limb
+ *   radix of limb_radix.h;
+ * - threads: square of n! by MulThreaded() from 1 to 64 threads, against the
+ *   single thread Karatsuba multiply;
+ * - kernels: Comba, add and subtract of the scalar path against the path
+ *   picked for this CPU (BMI2 / ADX kernels of limb_kernels.h), for operands
+ *   up to n limbs, then a Karatsuba multiply of n limbs on the picked path
+ *   (run again with CELLCRYPT_CPU_PATH=scalar to compare);
+ * - gmp: the radix work on BigNum and on GMP (built with -DCELLCRYPT_WITH_GMP
+ *   and -lgmp only);
+ * - stats: limb memory and operation counters of factorial() and
+ *   factorial_tree() for n doubling up to the given one, to model memory
+ *   against n (built with -DCELLCRYPT_STATS only).
+ *
+ * Usage: big_num_bench [radix|threads|kernels|gmp|stats [n]]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "big_num.h"
+#include "big_num_mul.h"
+#include "big_num_stats.h"
+#if defined(CELLCRYPT_WITH_GMP)
+#include "big_num_gmp.h"
+#endif
+
+namespace {
+
+/**
+ * \brief Time a function
+ * \return Best wall time of reps runs, in milliseconds
+ */
+template <typename Fn>
+double TimeMs(Fn &&fn, int reps = 3) {
+  double best = 0;
+  for (int i = 0; i < reps; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    const std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    if (i == 0 || ms.count() < best) {
+      best = ms.count();
+    }
+  }
+
+  return best;
+}
+
+/**
+ * \brief Print one number type row
+ * \param name Row name
+ * \param n Factorial argument
+ */
+template <typename Num>
+void BenchNum(const char *name, uint64_t n) {
+  Num f;
+  const double fact_ms = TimeMs([&] { f = factorial<Num>(n); });
+
+  Num sq;
+  const double square_ms = TimeMs([&] { Num::Mul(f, f, &sq); });
+
+  uint64_t sum = 0;
+  std::vector<char> buf(f.num_digits());
+  const double out_ms = TimeMs([&] {
+    sum = sum_of_digits(f);
+    f.ToChars(buf.data(), buf.size());
+  });
+
+  std::cout << std::left << std::setw(8) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(8) << f.num_limbs()
+            << std::setw(12) << fact_ms << std::setw(12) << square_ms
+            << std::setw(12) << out_ms << std::setw(10) << sum << std::endl;
+}
+
+/**
+ * \brief Print MulThreaded() time for 1 to 64 threads
+ * \param n Factorial argument; its square is timed
+ */
+void BenchThreads(uint64_t n) {
+  const BigNum f = factorial(n);
+  BigNum sq;
+  const double single_ms = TimeMs([&] { BigNum::Mul(f, f, &sq); });
+
+  std::cout << "limbs " << f.num_limbs() << ", hardware threads "
+            << std::thread::hardware_concurrency() << ", Karatsuba "
+            << std::fixed << std::setprecision(2) << single_ms << " ms"
+            << std::endl;
+  std::cout << "threads   time (ms)   speedup" << std::endl;
+
+  double one_ms = 0;
+  for (unsigned threads = 1; threads <= 64; threads *= 2) {
+    BigNum r;
+    const double ms = TimeMs([&] { MulThreaded(f, f, &r, threads); });
+    if (threads == 1) {
+      one_ms = ms;
+    }
+    if (r != sq) {
+      std::cout << "Mismatch at " << threads << " threads" << std::endl;
+    }
+    std::cout << std::setw(7) << threads << std::setw(12) << ms
+              << std::setw(10) << one_ms / ms << std::endl;
+  }
+}
+
+/**
+ * \brief Time a limb kernel on operands of n limbs for reps calls
+ * \return Nanoseconds per call
+ */
+template <typename Fn>
+double TimeKernelNs(Fn &&fn, size_t reps) {
+  return TimeMs([&] {
+           for (size_t i = 0; i < reps; ++i) {
+             fn();
+           }
+         }) *
+         1e6 / static_cast<double>(reps);
+}
+
+/**
+ * \brief Print time of the BigNum by BigNum kernels, scalar against the path
+ *        picked for this CPU
+ * \param n_max Largest operand, in limbs
+ */
+void BenchKernels(uint64_t n_max) {
+  const CpuKernels scalar = MakeCpuKernels(CpuPath::kScalar);
+  const CpuKernels &best = cpu_kernels();
+
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> a(n_max);
+  std::vector<uint64_t> b(n_max);
+  std::vector<uint64_t> r(2 * n_max);
+  for (size_t i = 0; i < n_max; ++i) {
+    a[i] = rng() % kLimbBase;
+    b[i] = rng() % kLimbBase;
+  }
+
+  std::cout << "limbs    comba (ns)  x      add (ns)  x      sub (ns)  x"
+            << std::endl;
+  for (size_t n = 8; n <= n_max && n <= kCombaMaxColumn; n *= 4) {
+    const size_t reps = std::max<size_t>(1, (1 << 26) / (n * n));
+    const size_t add_reps = std::max<size_t>(1, (1 << 24) / n);
+    auto comba = [&](const CpuKernels &k) {
+      return TimeKernelNs(
+          [&] { k.mul_comba(r.data(), a.data(), n, b.data(), n); }, reps);
+    };
+    auto add = [&](const CpuKernels &k) {
+      return TimeKernelNs([&] { k.add(r.data(), a.data(), b.data(), n); },
+                          add_reps);
+    };
+    auto sub = [&](const CpuKernels &k) {
+      return TimeKernelNs([&] { k.sub(r.data(), a.data(), b.data(), n); },
+                          add_reps);
+    };
+    const double comba_ns = comba(scalar);
+    const double add_ns = add(scalar);
+    const double sub_ns = sub(scalar);
+    std::cout << std::left << std::setw(7) << n << std::right << std::fixed
+              << std::setprecision(0) << std::setw(12) << comba_ns
+              << std::setprecision(2) << std::setw(6)
+              << comba_ns / comba(best) << std::setprecision(0)
+              << std::setw(12) << add_ns << std::setprecision(2)
+              << std::setw(6) << add_ns / add(best) << std::setprecision(0)
+              << std::setw(12) << sub_ns << std::setprecision(2)
+              << std::setw(6) << sub_ns / sub(best) << std::endl;
+  }
+
+  // Karatsuba goes through the table of this process only
+  std::vector<uint64_t> scratch(KaratsubaScratch(n_max));
+  const double karatsuba_ms = TimeMs(
+      [&] {
+        LimbsMulKaratsuba(r.data(), a.data(), n_max, b.data(), n_max,
+                          scratch.data());
+      },
+      10);
+  std::cout << "Karatsuba " << n_max << " limbs (" << best.name
+            << "): " << std::setprecision(2) << karatsuba_ms << " ms"
+            << std::endl;
+}
+
+/**
+ * \brief Print counters of factorial() and factorial_tree() for n doubling
+ * \param n_max Last factorial argument
+ */
+void BenchStats(uint64_t n_max) {
+  std::cout << "n          method  limbs     peak bytes  allocs  reallocs"
+               "     limb muls"
+            << std::endl;
+  auto row = [](uint64_t n, const char *method, const BigNum &f) {
+    const BigNumStats s = big_num_stats();
+    std::cout << std::left << std::setw(11) << n << std::setw(8) << method
+              << std::right << std::setw(7) << f.num_limbs() << std::setw(15)
+              << s.peak_bytes << std::setw(8) << s.allocations << std::setw(10)
+              << s.reallocations << std::setw(14) << s.limb_muls << std::endl;
+  };
+
+  for (uint64_t n = 1000; n <= n_max; n *= 2) {
+    ResetBigNumStats();
+    row(n, "word", factorial(n));
+    ResetBigNumStats();
+    row(n, "tree", factorial_tree(n));
+  }
+}
+
+}  // namespace
+
+/**
+ * \brief Entry point of BigNum benchmark
+ * \return 0 on success; -1 on error
+ */
+int main(int argc, char **argv) {
+  const std::string mode = argc > 1 ? argv[1] : "radix";
+  const uint64_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+
+  std::cout << "cpu path: " << cpu_kernels().name << std::endl;
+
+  if (mode == "radix") {
+    std::cout << "radix      limbs   fact (ms)  square (ms)   out (ms)  digit sum"
+              << std::endl;
+    BenchNum<BasicBigNum<Radix10e9>>("10^9", n);
+    BenchNum<BasicBigNum<Radix10e15>>("10^15", n);
+    BenchNum<BasicBigNum<Radix10e18>>("10^18", n);
+    BenchNum<BasicBigNum<Radix10e19>>("10^19", n);
+    BenchNum<BasicBigNum<Radix2e64>>("2^64", n);
+    return 0;
+  }
+#if defined(CELLCRYPT_WITH_GMP)
+  if (mode == "gmp") {
+    std::cout << "engine     limbs   fact (ms)  square (ms)   out (ms)  digit sum"
+              << std::endl;
+    BenchNum<BigNum>("BigNum", n);
+    BenchNum<GmpBigNum>("GMP", n);
+    return 0;
+  }
+#endif
+  if (mode == "stats") {
+    if (!kBigNumStats) {
+      std::cout << "stats needs a build with -DCELLCRYPT_STATS" << std::endl;
+      return -1;
+    }
+    BenchStats(n);
+    return 0;
+  }
+  if (mode == "threads") {
+    BenchThreads(n);
+    return 0;
+  }
+  if (mode == "kernels") {
+    BenchKernels(n);
+    return 0;
+  }
+
+  std::cout << "Unknown mode " << mode << std::endl;
+
+  return -1;
+}
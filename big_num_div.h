@@ -0,0 +1,301 @@
+/**
+ * \brief Cellcrypt big number division
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * BigNum by BigNum division.
+ *
+ * - Small sizes use schoolbook long division (Knuth TAOCP vol. 2, 4.3.1,
+ *   Algorithm D) on base 10^15 limbs;
+ * - From kDivNewtonThreshold limbs on (both divisor and quotient), quotient is
+ *   taken from a reciprocal of the divisor computed by Newton iteration, so
+ *   division costs a few multiplications and follows BigNum multiply speed;
+ * - Every result is exact: approximations are fixed up against the remainder.
+ */
+
+#ifndef BIG_NUM_DIV_H_
+#define BIG_NUM_DIV_H_
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "big_num.h"
+
+//! Divisor and quotient limbs from which Newton beats Algorithm D. Over
+//! Karatsuba multiply the crossover is between 80 and 160 limbs; at 1280 limbs
+//! Newton is about 4 times faster.
+constexpr size_t kDivNewtonThreshold = 128;
+
+/**
+ * \brief Divide by schoolbook long division (Knuth Algorithm D)
+ * \param a Dividend
+ * \param b Divisor (must not be zero)
+ * \param q Quotient (may be null)
+ * \param r Remainder (may be null)
+ */
+inline void DivModSchoolbook(const BigNum &a, const BigNum &b, BigNum *q,
+                             BigNum *r) {
+  assert(!b.IsZero());
+  constexpr uint64_t kBase = BigNum::kBase;
+  const size_t n = a.num_limbs();
+  const size_t m = b.num_limbs();
+
+  if (a < b) {
+    if (r != nullptr) {
+      *r = a;
+    }
+    if (q != nullptr) {
+      *q = BigNum();
+    }
+    return;
+  }
+
+  BigNum quot;
+  if (m == 1) {
+    const uint64_t rem = BigNum::DivMod(a, b.big_num_raw()[0], &quot);
+    if (r != nullptr) {
+      *r = BigNum(rem);
+    }
+    if (q != nullptr) {
+      *q = std::move(quot);
+    }
+    return;
+  }
+
+  // normalize so top divisor limb is at least base / 2; keeps qhat within 2
+  const uint64_t f = kBase / (b.big_num_raw()[m - 1] + 1);
+  std::vector<uint64_t> u(n + 1);
+  std::vector<uint64_t> v(m);
+  u[n] = LimbsMulSmall(u.data(), a.big_num_raw().data(), n, f);
+  LimbsMulSmall(v.data(), b.big_num_raw().data(), m, f);
+
+  uint64_t *qd = quot.LimbsWrite(n - m + 1);
+  for (size_t j = n - m + 1; j-- > 0;) {
+    // estimate quotient limb from top two limbs, then refine with third one
+    uint64_t qhat = kBase - 1;
+    unsigned __int128 rhat = 0;
+    const unsigned __int128 num =
+        static_cast<unsigned __int128>(u[j + m]) * kBase + u[j + m - 1];
+    if (u[j + m] >= v[m - 1]) {
+      rhat = num - static_cast<unsigned __int128>(qhat) * v[m - 1];
+    } else {
+      uint64_t rem = 0;
+      qhat = Div128By64(static_cast<uint64_t>(num >> 64),
+                        static_cast<uint64_t>(num), v[m - 1], &rem);
+      rhat = rem;
+    }
+    while (rhat < kBase && static_cast<unsigned __int128>(qhat) * v[m - 2] >
+                               rhat * kBase + u[j + m - 2]) {
+      --qhat;
+      rhat += v[m - 1];
+    }
+
+    // u[j..j+m] -= qhat * v
+    uint64_t carry = 0;
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < m; ++i) {
+      const unsigned __int128 prod =
+          static_cast<unsigned __int128>(qhat) * v[i] + carry;
+      uint64_t lo = 0;
+      carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(prod >> 64),
+                                       static_cast<uint64_t>(prod), &lo);
+      u[j + i] = LimbSub(u[j + i], lo, &borrow);
+    }
+
+    const uint64_t top = carry + borrow;
+    if (u[j + m] >= top) {
+      u[j + m] -= top;
+    } else {
+      // qhat was one too big (rare): add divisor back
+      u[j + m] = u[j + m] + kBase - top;
+      --qhat;
+      const uint64_t c = LimbsAdd(u.data() + j, u.data() + j, v.data(), m);
+      u[j + m] = u[j + m] + c - kBase;
+    }
+
+    qd[j] = qhat;
+  }
+  quot.LimbsFinish();
+
+  if (r != nullptr) {
+    BigNum rem;
+    LimbsDivSmall(rem.LimbsWrite(m), u.data(), m, f);
+    rem.LimbsFinish();
+    *r = std::move(rem);
+  }
+  if (q != nullptr) {
+    *q = std::move(quot);
+  }
+}
+
+/**
+ * \brief Approximates base^k / d by Newton iteration (within a few units)
+ *
+ * Each level halves the precision, so total cost is a small multiple of one
+ * multiplication of the result size.
+ *
+ * \param d Divisor (must not be zero)
+ * \param k Power of base (in limbs) to divide
+ * \return Approximation of base^k / d
+ */
+inline BigNum ReciprocalApprox(const BigNum &d, size_t k) {
+  assert(!d.IsZero());
+  const size_t m = d.num_limbs();
+  if (k < m) {
+    return BigNum();
+  }
+
+  const size_t p = k - m + 1;  // result limbs
+  BigNum x;
+  if (p <= kDivNewtonThreshold) {
+    BigNum pow_k(1);
+    DivModSchoolbook(pow_k.ShiftLimbsLeft(k), d, &x, nullptr);
+    return x;
+  }
+
+  // half precision from the top limbs of d
+  const size_t h = p / 2 + 1;
+  const size_t t = std::min(m, h + 1);
+  BigNum d_top(d);
+  d_top.ShiftLimbsRight(m - t);
+  x = ReciprocalApprox(d_top, h + t);
+  x.ShiftLimbsLeft(p - 1 - h);
+
+  // one Newton step: x += x * (base^k - d * x) / base^k; error term e has
+  // only about p - h significant limbs, the ones below can be dropped
+  BigNum pow_k(1);
+  pow_k.ShiftLimbsLeft(k);
+  const BigNum dx = d * x;
+  const bool below = dx <= pow_k;
+  BigNum e = below ? pow_k - dx : dx - pow_k;
+  const size_t drop = m > 2 ? m - 2 : 0;
+  e.ShiftLimbsRight(drop);
+
+  BigNum c = x * e;
+  c.ShiftLimbsRight(k - drop);
+  if (below) {
+    x += c;
+  } else {
+    x -= c < x ? c : x;
+  }
+
+  return x;
+}
+
+/**
+ * \brief Calculates floor(base^k / d) by Newton iteration
+ * \param d Divisor (must not be zero)
+ * \param k Power of base (in limbs) to divide
+ * \return floor(base^k / d)
+ */
+inline BigNum Reciprocal(const BigNum &d, size_t k) {
+  BigNum x = ReciprocalApprox(d, k);
+
+  BigNum pow_k(1);
+  pow_k.ShiftLimbsLeft(k);
+
+  // fix up last units
+  const BigNum one(1);
+  BigNum dx = d * x;
+  while (dx > pow_k) {
+    x -= one;
+    dx -= d;
+  }
+  BigNum e = pow_k - dx;
+  while (e >= d) {
+    x += one;
+    e -= d;
+  }
+
+  return x;
+}
+
+/**
+ * \brief Divide by multiplying with reciprocal of the divisor
+ * \param a Dividend
+ * \param b Divisor (must not be zero)
+ * \param q Quotient (may be null)
+ * \param r Remainder (may be null)
+ */
+inline void DivModNewton(const BigNum &a, const BigNum &b, BigNum *q,
+                         BigNum *r) {
+  assert(!b.IsZero());
+  const size_t n = a.num_limbs();
+  const size_t m = b.num_limbs();
+
+  if (a < b) {
+    DivModSchoolbook(a, b, q, r);
+    return;
+  }
+
+  // quotient has p limbs, so only top p + 2 limbs of divisor matter
+  const size_t p = n - m + 1;
+  const size_t s = m > p + 2 ? m - (p + 2) : 0;
+  BigNum d(b);
+  BigNum a_s(a);
+  d.ShiftLimbsRight(s);
+  a_s.ShiftLimbsRight(s);
+
+  const size_t k = n - s;
+  BigNum quot = a_s * ReciprocalApprox(d, k);
+  quot.ShiftLimbsRight(k);
+
+  // estimate is a few units off either way
+  const BigNum one(1);
+  BigNum qb = quot * b;
+  while (qb > a) {
+    quot -= one;
+    qb -= b;
+  }
+  BigNum rem = a - qb;
+  while (rem >= b) {
+    quot += one;
+    rem -= b;
+  }
+
+  if (r != nullptr) {
+    *r = std::move(rem);
+  }
+  if (q != nullptr) {
+    *q = std::move(quot);
+  }
+}
+
+/**
+ * \brief Divide, picking algorithm by size
+ * \param a Dividend
+ * \param b Divisor (must not be zero)
+ * \param q Quotient (may be null)
+ * \param r Remainder (may be null)
+ */
+inline void DivMod(const BigNum &a, const BigNum &b, BigNum *q, BigNum *r) {
+  const size_t m = b.num_limbs();
+  const size_t n = a.num_limbs();
+
+  if (m < kDivNewtonThreshold || n < m + kDivNewtonThreshold) {
+    DivModSchoolbook(a, b, q, r);
+  } else {
+    DivModNewton(a, b, q, r);
+  }
+}
+
+inline BigNum operator/(const BigNum &a, const BigNum &b) {
+  BigNum q;
+  DivMod(a, b, &q, nullptr);
+
+  return q;
+}
+
+inline BigNum operator%(const BigNum &a, const BigNum &b) {
+  BigNum r;
+  DivMod(a, b, nullptr, &r);
+
+  return r;
+}
+
+#endif  // BIG_NUM_DIV_H_
@@ -0,0 +1,186 @@
+/**
+ * \brief Cellcrypt GMP big number backend
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * GmpBigNum has the BigNum interface used by factorial programs on a GMP mpz_t:
+ * factorial<GmpBigNum>() is mpz_fac_ui() and digits come from mpz_get_str().
+ *
+ * Only built with -DCELLCRYPT_WITH_GMP (and -lgmp); programs then take it for
+ * factorials, and big_num_bench times BigNum against it. Without the macro the
+ * in-house engine is the only one and GMP is not needed.
+ */
+
+#ifndef BIG_NUM_GMP_H_
+#define BIG_NUM_GMP_H_
+
+#if !defined(CELLCRYPT_WITH_GMP)
+#error "big_num_gmp.h needs -DCELLCRYPT_WITH_GMP and -lgmp"
+#endif
+
+#include <gmp.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "big_num.h"
+
+/**
+ * \brief GmpBigNum class
+ *
+ * Big number on a GMP mpz_t, with the part of the BigNum interface needed by
+ * factorial(), sum_of_digits() and output
+ */
+class GmpBigNum {
+ public:
+  /**
+   * \brief Constructor by number
+   * \param num Initial value
+   */
+  explicit GmpBigNum(uint64_t num = 0) {
+    static_assert(sizeof(unsigned long) == sizeof(uint64_t),
+                  "mpz_*_ui takes 64 bit values");
+    mpz_init_set_ui(z_, num);
+  }
+
+  GmpBigNum(const GmpBigNum &other) { mpz_init_set(z_, other.z_); }
+
+  GmpBigNum(GmpBigNum &&other) noexcept {
+    mpz_init(z_);
+    mpz_swap(z_, other.z_);
+  }
+
+  GmpBigNum &operator=(const GmpBigNum &other) {
+    mpz_set(z_, other.z_);
+    return *this;
+  }
+
+  GmpBigNum &operator=(GmpBigNum &&other) noexcept {
+    mpz_swap(z_, other.z_);
+    return *this;
+  }
+
+  ~GmpBigNum() { mpz_clear(z_); }
+
+  /**
+   * \brief r = a * b (r may be a or b)
+   */
+  static void Mul(const GmpBigNum &a, const GmpBigNum &b, GmpBigNum *r) {
+    mpz_mul(r->z_, a.z_, b.z_);
+  }
+
+  GmpBigNum &operator*=(uint64_t num) {
+    mpz_mul_ui(z_, z_, num);
+    return *this;
+  }
+
+  /**
+   * \brief Replace value by the factorial of a number
+   * \param num Number to calculate factorial
+   */
+  void SetFactorial(uint64_t num) { mpz_fac_ui(z_, num); }
+
+  bool IsZero() const { return mpz_sgn(z_) == 0; }
+
+  /**
+   * \brief Get number of limbs (binary, 64 bits each)
+   */
+  size_t num_limbs() const { return mpz_size(z_); }
+
+  bool operator==(const GmpBigNum &other) const {
+    return mpz_cmp(z_, other.z_) == 0;
+  }
+
+  /**
+   * \brief Get number of decimal digits
+   * \return Digits (1 for zero)
+   */
+  size_t num_digits() const {
+    // mpz_sizeinbase may be one too big: check against 10^(digits - 1)
+    const size_t digits = mpz_sizeinbase(z_, 10);
+    if (digits <= 1) {
+      return 1;
+    }
+    mpz_t p;
+    mpz_init(p);
+    mpz_ui_pow_ui(p, 10, digits - 1);
+    const bool less = mpz_cmp(z_, p) < 0;
+    mpz_clear(p);
+
+    return less ? digits - 1 : digits;
+  }
+
+  /**
+   * \brief Write decimal digits (no terminator)
+   * \param buf Output buffer
+   * \param len Size of buf; at least num_digits()
+   * \return Number of chars written; 0 if buf is too small
+   */
+  size_t ToChars(char *buf, size_t len) const {
+    // mpz_get_str needs room for sizeinbase digits and a terminator
+    std::vector<char> digits(mpz_sizeinbase(z_, 10) + 2);
+    mpz_get_str(digits.data(), 10, z_);
+    size_t n = 0;
+    while (digits[n] != '\0') {
+      ++n;
+    }
+    if (len < n) {
+      return 0;
+    }
+    std::copy(digits.begin(), digits.begin() + n, buf);
+
+    return n;
+  }
+
+  /**
+   * \brief Get GMP number
+   * \return Read only mpz (valid while this object lives)
+   */
+  mpz_srcptr mpz() const { return z_; }
+
+ private:
+  mpz_t z_;  //!< GMP number
+};
+
+/**
+ * \brief Calculates the factorial of a number (mpz_fac_ui)
+ * \param num Number to calculate factorial
+ * \return Factorial of given number
+ */
+template <>
+inline GmpBigNum factorial<GmpBigNum>(uint64_t num) {
+  GmpBigNum f;
+  f.SetFactorial(num);
+
+  return f;
+}
+
+/**
+ * \brief Calculates the sum of digits of a number (mpz_get_str)
+ * \param big_num Number to calculate the sum
+ * \return Sum of digits of given number
+ */
+inline uint64_t sum_of_digits(const GmpBigNum &big_num) {
+  std::vector<char> digits(mpz_sizeinbase(big_num.mpz(), 10) + 2);
+  mpz_get_str(digits.data(), 10, big_num.mpz());
+  uint64_t sum = 0;
+  for (const char *c = digits.data(); *c != '\0'; ++c) {
+    sum += static_cast<uint64_t>(*c - '0');
+  }
+
+  return sum;
+}
+
+inline std::ostream &operator<<(std::ostream &o, const GmpBigNum &big_num) {
+  std::vector<char> digits(mpz_sizeinbase(big_num.mpz(), 10) + 2);
+  mpz_get_str(digits.data(), 10, big_num.mpz());
+
+  return o << digits.data();
+}
+
+#endif  // BIG_NUM_GMP_H_
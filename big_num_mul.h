@@ -0,0 +1,149 @@
+/**
+ * \brief Cellcrypt multi-threaded big number multiplication
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * BigNum by BigNum multiplication split over threads.
+ *
+ * Output columns are cut into one contiguous range per thread, sized so every
+ * range takes the same number of limb products (columns in the middle of a
+ * product take more of them). Each thread sums its columns from L1 sized
+ * tiles of both operands (LimbsMulColumns()) and resolves carries inside its
+ * own range; only one carry per range is left, added in a last short pass.
+ */
+
+#ifndef BIG_NUM_MUL_H_
+#define BIG_NUM_MUL_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "big_num.h"
+
+/**
+ * \brief Split product columns into ranges of about the same work
+ * \param n Limbs of one operand
+ * \param m Limbs of the other operand
+ * \param parts Number of ranges
+ * \return parts + 1 column bounds, from 0 to n + m - 1
+ */
+inline std::vector<size_t> MulColumnRanges(size_t n, size_t m, size_t parts) {
+  const size_t columns = n + m - 1;
+  const size_t total = n * m;
+  std::vector<size_t> bounds(parts + 1, columns);
+  bounds[0] = 0;
+
+  size_t done = 0;
+  size_t part = 1;
+  for (size_t c = 0; c < columns && part < parts; ++c) {
+    // products in column c: i in [c - m + 1, c] within [0, n)
+    const size_t lo = c < m ? 0 : c - m + 1;
+    done += std::min(c, n - 1) - lo + 1;
+    while (part < parts && done * parts >= total * part) {
+      bounds[part++] = c + 1;
+    }
+  }
+
+  return bounds;
+}
+
+/**
+ * \brief r = a * b, columns computed by several threads
+ * \param r Output of n + m limbs (must not overlap a or b)
+ * \param a Operand of n limbs
+ * \param b Operand of m limbs (m <= kCombaMaxColumn)
+ * \param threads Number of threads (0 or 1 runs on the calling thread)
+ */
+inline void LimbsMulThreaded(uint64_t *r, const uint64_t *a, size_t n,
+                             const uint64_t *b, size_t m, unsigned threads) {
+  assert(m <= kCombaMaxColumn);
+  const size_t columns = n + m - 1;
+  const size_t parts = std::max<size_t>(1, std::min<size_t>(threads, columns));
+  const std::vector<size_t> bounds = MulColumnRanges(n, m, parts);
+  std::vector<uint64_t> carries(parts);
+
+  auto run = [&](size_t part) {
+    const size_t c0 = bounds[part];
+    const size_t c1 = bounds[part + 1];
+    std::vector<unsigned __int128> acc(c1 - c0);
+    LimbsMulColumns(acc.data(), a, n, b, m, c0, c1);
+    carries[part] = LimbsColumnsToLimbs(r + c0, acc.data(), c1 - c0);
+  };
+
+  std::vector<std::thread> pool;
+  pool.reserve(parts - 1);
+  for (size_t part = 1; part < parts; ++part) {
+    pool.emplace_back(run, part);
+  }
+  run(0);
+  for (std::thread &t : pool) {
+    t.join();
+  }
+
+  // carry out of each range goes in at the first column of the next one
+  r[columns] = 0;
+  for (size_t part = 0; part < parts; ++part) {
+    const size_t c = bounds[part + 1];
+    uint64_t carry[2];
+    carry[0] = carries[part] % kLimbBase;
+    carry[1] = carries[part] / kLimbBase;
+    const size_t k = std::min<size_t>(2, n + m - c);
+    const uint64_t over = LimbsAdd(r + c, r + c, carry, k);
+    LimbsAddCarry(r + c + k, r + c + k, n + m - c - k, over);
+  }
+}
+
+/**
+ * \brief r = a * b, columns computed by several threads
+ *
+ * A column sums at most kCombaMaxColumn products in 128 bits, so a shorter
+ * operand longer than that is cut into pieces of kCombaMaxColumn limbs, whose
+ * products are added up.
+ *
+ * \param a First operand
+ * \param b Second operand
+ * \param r Product (may be a or b)
+ * \param threads Number of threads (0 or 1 runs on the calling thread)
+ */
+inline void MulThreaded(const BigNum &a, const BigNum &b, BigNum *r,
+                        unsigned threads) {
+  const uint64_t *pa = a.big_num_raw().data();
+  const uint64_t *pb = b.big_num_raw().data();
+  size_t n = a.num_limbs();
+  size_t m = b.num_limbs();
+  if (n == 0 || m == 0) {
+    *r = BigNum();
+    return;
+  }
+  if (m > n) {
+    std::swap(pa, pb);
+    std::swap(n, m);
+  }
+
+  BigNum prod;
+  uint64_t *out = prod.LimbsWrite(n + m);
+  if (m <= kCombaMaxColumn) {
+    LimbsMulThreaded(out, pa, n, pb, m, threads);
+  } else {
+    std::fill(out, out + n + m, 0);
+    std::vector<uint64_t> part(n + kCombaMaxColumn);
+    for (size_t j = 0; j < m; j += kCombaMaxColumn) {
+      const size_t k = std::min(kCombaMaxColumn, m - j);
+      LimbsMulThreaded(part.data(), pa, n, pb + j, k, threads);
+      const uint64_t carry = LimbsAdd(out + j, out + j, part.data(), n + k);
+      LimbsAddCarry(out + j + n + k, out + j + n + k, m - j - k, carry);
+    }
+  }
+
+  prod.LimbsFinish();
+  *r = std::move(prod);
+}
+
+#endif  // BIG_NUM_MUL_H_
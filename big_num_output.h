@@ -0,0 +1,271 @@
+/**
+ * \brief Cellcrypt big number output
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Decimal output of huge BigNum values without stream buffers.
+ *
+ * Lower limbs are cut into blocks of kOutputBlockLimbs; every block has a
+ * fixed place in the output (kDigitsPerLimb chars per limb), so threads format
+ * blocks straight into their own regions:
+ *
+ * - WriteDecimalFile(): regions of an mmapped output file;
+ * - WriteDecimalFd(): regions of a page aligned buffer, handed to a pipe with
+ *   vmsplice() in order as blocks get done, so the reader starts on the first
+ *   block while others are still being formatted (plain write() when fd is
+ *   not a pipe).
+ */
+
+#ifndef BIG_NUM_OUTPUT_H_
+#define BIG_NUM_OUTPUT_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "big_num.h"
+
+//! Limbs formatted by a thread at a time (15 MiB of digits)
+constexpr size_t kOutputBlockLimbs = 1 << 20;
+
+enum class OutputRetCode { kOK, kOpenFailed, kMapFailed, kWriteFailed };
+
+/**
+ * \brief Formats decimal digits of a BigNum block by block
+ */
+class DecimalBlocks {
+ public:
+  /**
+   * \brief Constructor by number
+   * \param big_num Number to format (must outlive this object)
+   */
+  explicit DecimalBlocks(const BigNum &big_num)
+      : big_num_(big_num),
+        digits_(big_num.num_digits()),
+        lower_(big_num.IsZero() ? 0 : big_num.num_limbs() - 1),
+        top_digits_(digits_ - lower_ * BigNum::kDigitsPerLimb) {}
+
+  //! Number of decimal digits
+  size_t digits() const { return digits_; }
+
+  //! Number of blocks; block 0 holds the top limb and the most significant
+  size_t num_blocks() const {
+    return 1 + (lower_ + kOutputBlockLimbs - 1) / kOutputBlockLimbs;
+  }
+
+  /**
+   * \brief Output range of a block
+   * \param block Block index
+   * \param begin First char of the block
+   * \return End of the block
+   */
+  size_t Range(size_t block, size_t *begin) const {
+    if (block == 0) {
+      *begin = 0;
+      return top_digits_;
+    }
+    const size_t hi = lower_ - (block - 1) * kOutputBlockLimbs;
+    const size_t lo = hi - std::min(hi, kOutputBlockLimbs);
+    *begin = top_digits_ + (lower_ - hi) * BigNum::kDigitsPerLimb;
+
+    return *begin + (hi - lo) * BigNum::kDigitsPerLimb;
+  }
+
+  /**
+   * \brief Format a block into its place
+   * \param block Block index
+   * \param out Output of digits() chars
+   */
+  void Format(size_t block, char *out) const {
+    const uint64_t *limbs = big_num_.big_num_raw().data();
+    if (block == 0) {
+      // top limb is not padded
+      const BigNum top(big_num_.IsZero() ? 0 : limbs[lower_]);
+      top.ToChars(out, top_digits_);
+      return;
+    }
+
+    size_t begin = 0;
+    const size_t end = Range(block, &begin);
+    const size_t count = (end - begin) / BigNum::kDigitsPerLimb;
+    const size_t hi = lower_ - (block - 1) * kOutputBlockLimbs;
+    BigNum::Ops::Format(out + begin, limbs + hi - count, count);
+  }
+
+ private:
+  const BigNum &big_num_;  //!< Number formatted
+  size_t digits_;          //!< Decimal digits
+  size_t lower_;           //!< Limbs below the top one
+  size_t top_digits_;      //!< Digits of the top limb
+};
+
+/**
+ * \brief Run fn(block) for every block, on several threads
+ * \param num_blocks Number of blocks
+ * \param threads Number of threads (0 or 1 runs on the calling thread)
+ * \param fn Function of a block index; blocks are taken in order
+ */
+template <typename Fn>
+void ForEachBlock(size_t num_blocks, unsigned threads, Fn &&fn) {
+  std::atomic<size_t> next{0};
+  auto run = [&] {
+    for (size_t b = next++; b < num_blocks; b = next++) {
+      fn(b);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads && t < num_blocks; ++t) {
+    pool.emplace_back(run);
+  }
+  run();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+}
+
+/**
+ * \brief Write decimal digits and a newline into a file through mmap
+ * \param big_num Number to write
+ * \param file_name Output file (created or truncated)
+ * \param threads Formatting threads
+ * \return kOK; error code otherwise
+ */
+inline OutputRetCode WriteDecimalFile(const BigNum &big_num,
+                                      const std::string &file_name,
+                                      unsigned threads) {
+  const DecimalBlocks blocks(big_num);
+  const size_t size = blocks.digits() + 1;
+
+  const int fd = open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return OutputRetCode::kOpenFailed;
+  }
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    close(fd);
+    return OutputRetCode::kWriteFailed;
+  }
+  void *map = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return OutputRetCode::kMapFailed;
+  }
+
+  char *out = static_cast<char *>(map);
+  ForEachBlock(blocks.num_blocks(), threads,
+               [&](size_t b) { blocks.Format(b, out); });
+  out[size - 1] = '\n';
+
+  return munmap(map, size) == 0 ? OutputRetCode::kOK
+                                : OutputRetCode::kWriteFailed;
+}
+
+/**
+ * \brief Write all bytes, with vmsplice() on a pipe and write() otherwise
+ * \param fd Output file descriptor
+ * \param data Bytes (not changed until the reader consumed them)
+ * \param len Number of bytes
+ * \param splice In: try vmsplice(); out: false once fd turned out no pipe
+ * \return true on success; false on error
+ */
+inline bool WriteAll(int fd, const char *data, size_t len, bool *splice) {
+  while (len > 0) {
+    ssize_t got = -1;
+    if (*splice) {
+      iovec iov{const_cast<char *>(data), len};
+      got = vmsplice(fd, &iov, 1, 0);
+      if (got < 0 && (errno == EBADF || errno == EINVAL)) {
+        *splice = false;
+        continue;
+      }
+    } else {
+      got = write(fd, data, len);
+    }
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += got;
+    len -= static_cast<size_t>(got);
+  }
+
+  return true;
+}
+
+/**
+ * \brief Write decimal digits and a newline to a file descriptor
+ *
+ * Blocks are formatted by threads into one page aligned buffer and handed to
+ * fd in order as soon as each is done.
+ *
+ * \param big_num Number to write
+ * \param fd Output (a pipe gets the pages by vmsplice; anything else write)
+ * \param threads Formatting threads (besides the one writing)
+ * \return kOK; error code otherwise
+ */
+inline OutputRetCode WriteDecimalFd(const BigNum &big_num, int fd,
+                                    unsigned threads) {
+  const DecimalBlocks blocks(big_num);
+  const size_t size = blocks.digits() + 1;
+  const size_t num_blocks = blocks.num_blocks();
+
+  // spliced pages must stay as they are until read: unmapped only at the end,
+  // and the pipe keeps its own reference to them
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (map == MAP_FAILED) {
+    return OutputRetCode::kMapFailed;
+  }
+  char *out = static_cast<char *>(map);
+  out[size - 1] = '\n';
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::unique_ptr<bool[]> done(new bool[num_blocks]());
+  std::thread formatter([&] {
+    ForEachBlock(num_blocks, std::max(threads, 1u), [&](size_t b) {
+      blocks.Format(b, out);
+      const std::lock_guard<std::mutex> lock(mutex);
+      done[b] = true;
+      cond.notify_all();
+    });
+  });
+
+  bool splice = true;
+  bool ok = true;
+  for (size_t b = 0; b < num_blocks; ++b) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return done[b]; });
+    }
+    size_t begin = 0;
+    size_t end = blocks.Range(b, &begin);
+    if (b + 1 == num_blocks) {
+      end = size;  // with the newline
+    }
+    ok = ok && WriteAll(fd, out + begin, end - begin, &splice);
+  }
+  formatter.join();
+  munmap(map, size);
+
+  return ok ? OutputRetCode::kOK : OutputRetCode::kWriteFailed;
+}
+
+#endif  // BIG_NUM_OUTPUT_H_
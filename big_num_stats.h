@@ -0,0 +1,236 @@
+/**
+ * \brief Cellcrypt big number counters
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Opt-in BigNum counters, for capacity planning.
+ *
+ * Built with -DCELLCRYPT_STATS, BigNum limbs are held by a LimbVector that
+ * counts heap bytes (current and peak), allocations, reallocations and frees,
+ * and BigNum operations count limb products and carry propagation runs. All
+ * counters are process wide (relaxed atomics) and read with big_num_stats().
+ *
+ * Without the macro LimbVector is std::vector, the hooks are empty and
+ * big_num_stats() returns zeros.
+ */
+
+#ifndef BIG_NUM_STATS_H_
+#define BIG_NUM_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(CELLCRYPT_STATS)
+#include <atomic>
+#include <memory>
+#endif
+
+/**
+ * \brief Snapshot of BigNum counters
+ */
+struct BigNumStats {
+  uint64_t current_bytes;  //!< Limb bytes allocated now
+  uint64_t peak_bytes;     //!< Most limb bytes allocated at once
+  uint64_t allocations;    //!< Limb buffers allocated
+  uint64_t reallocations;  //!< Allocations that moved a BigNum to more room
+  uint64_t frees;          //!< Limb buffers freed
+  uint64_t limb_muls;      //!< Limb by limb products (n * m per BigNum product)
+  uint64_t carry_runs;     //!< Carries or borrows past the shorter operand
+  uint64_t carry_limbs;    //!< Limbs those runs went through
+  uint64_t carry_max;      //!< Longest run
+};
+
+#if defined(CELLCRYPT_STATS)
+
+/**
+ * \brief Process wide counters behind BigNumStats
+ */
+struct BigNumCounters {
+  std::atomic<uint64_t> current_bytes{0};
+  std::atomic<uint64_t> peak_bytes{0};
+  std::atomic<uint64_t> allocations{0};
+  std::atomic<uint64_t> reallocations{0};
+  std::atomic<uint64_t> frees{0};
+  std::atomic<uint64_t> limb_muls{0};
+  std::atomic<uint64_t> carry_runs{0};
+  std::atomic<uint64_t> carry_limbs{0};
+  std::atomic<uint64_t> carry_max{0};
+};
+
+inline BigNumCounters &big_num_counters() {
+  static BigNumCounters counters;
+  return counters;
+}
+
+/**
+ * \brief Raise an atomic maximum
+ */
+inline void StatsMax(std::atomic<uint64_t> *max, uint64_t value) {
+  uint64_t cur = max->load(std::memory_order_relaxed);
+  while (value > cur &&
+         !max->compare_exchange_weak(cur, value, std::memory_order_relaxed)) {
+  }
+}
+
+/**
+ * \brief std::allocator counting bytes in BigNumCounters
+ */
+template <typename T>
+struct StatsAllocator : std::allocator<T> {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = StatsAllocator<U>;
+  };
+
+  StatsAllocator() = default;
+  template <typename U>
+  StatsAllocator(const StatsAllocator<U> &) {}
+
+  T *allocate(size_t n) {
+    BigNumCounters &c = big_num_counters();
+    const uint64_t bytes = n * sizeof(T);
+    c.allocations.fetch_add(1, std::memory_order_relaxed);
+    StatsMax(&c.peak_bytes,
+             c.current_bytes.fetch_add(bytes, std::memory_order_relaxed) +
+                 bytes);
+    return std::allocator<T>::allocate(n);
+  }
+
+  void deallocate(T *p, size_t n) {
+    BigNumCounters &c = big_num_counters();
+    c.frees.fetch_add(1, std::memory_order_relaxed);
+    c.current_bytes.fetch_sub(n * sizeof(T), std::memory_order_relaxed);
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const StatsAllocator<T> &, const StatsAllocator<U> &) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const StatsAllocator<T> &, const StatsAllocator<U> &) {
+  return false;
+}
+
+/**
+ * \brief std::vector of limbs counting allocations and reallocations
+ *
+ * Growing members note a reallocation when an existing buffer is replaced.
+ */
+template <typename T>
+class LimbVector : public std::vector<T, StatsAllocator<T>> {
+  using Base = std::vector<T, StatsAllocator<T>>;
+
+ public:
+  using Base::Base;
+
+  void resize(size_t n) {
+    Grow(n);
+    Base::resize(n);
+  }
+
+  void reserve(size_t n) {
+    Grow(n);
+    Base::reserve(n);
+  }
+
+  void push_back(const T &value) {
+    Grow(this->size() + 1);
+    Base::push_back(value);
+  }
+
+ private:
+  void Grow(size_t n) {
+    if (n > this->capacity() && this->capacity() > 0) {
+      big_num_counters().reallocations.fetch_add(1,
+                                                 std::memory_order_relaxed);
+    }
+  }
+};
+
+/**
+ * \brief Count limb by limb products
+ */
+inline void StatsLimbMuls(uint64_t n) {
+  big_num_counters().limb_muls.fetch_add(n, std::memory_order_relaxed);
+}
+
+/**
+ * \brief Count a carry (or borrow) run of len limbs
+ */
+inline void StatsCarry(uint64_t len) {
+  BigNumCounters &c = big_num_counters();
+  c.carry_runs.fetch_add(1, std::memory_order_relaxed);
+  c.carry_limbs.fetch_add(len, std::memory_order_relaxed);
+  StatsMax(&c.carry_max, len);
+}
+
+/**
+ * \brief Take a snapshot of the counters
+ */
+inline BigNumStats big_num_stats() {
+  const BigNumCounters &c = big_num_counters();
+  return {c.current_bytes.load(), c.peak_bytes.load(), c.allocations.load(),
+          c.reallocations.load(), c.frees.load(),      c.limb_muls.load(),
+          c.carry_runs.load(),    c.carry_limbs.load(), c.carry_max.load()};
+}
+
+/**
+ * \brief Zero the counters (peak restarts from current bytes)
+ */
+inline void ResetBigNumStats() {
+  BigNumCounters &c = big_num_counters();
+  c.peak_bytes = c.current_bytes.load();
+  c.allocations = 0;
+  c.reallocations = 0;
+  c.frees = 0;
+  c.limb_muls = 0;
+  c.carry_runs = 0;
+  c.carry_limbs = 0;
+  c.carry_max = 0;
+}
+
+#else  // !defined(CELLCRYPT_STATS)
+
+template <typename T>
+using LimbVector = std::vector<T>;
+
+inline void StatsLimbMuls(uint64_t) {}
+inline void StatsCarry(uint64_t) {}
+inline BigNumStats big_num_stats() { return {}; }
+inline void ResetBigNumStats() {}
+
+#endif  // defined(CELLCRYPT_STATS)
+
+//! true if counters are built in
+constexpr bool kBigNumStats =
+#if defined(CELLCRYPT_STATS)
+    true;
+#else
+    false;
+#endif
+
+/**
+ * \brief Print counters, one per line
+ */
+inline std::ostream &operator<<(std::ostream &o, const BigNumStats &s) {
+  return o << "limb bytes current: " << s.current_bytes << '\n'
+           << "limb bytes peak:    " << s.peak_bytes << '\n'
+           << "allocations:        " << s.allocations << '\n'
+           << "reallocations:      " << s.reallocations << '\n'
+           << "frees:              " << s.frees << '\n'
+           << "limb multiplies:    " << s.limb_muls << '\n'
+           << "carry runs:         " << s.carry_runs << '\n'
+           << "carry limbs:        " << s.carry_limbs << '\n'
+           << "longest carry:      " << s.carry_max << '\n';
+}
+
+#endif  // BIG_NUM_STATS_H_
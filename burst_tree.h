@@ -0,0 +1,362 @@
+/**
+ * \brief Cellcrypt burst word tree
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Burst trie of words: trie nodes on the upper levels, containers below.
+ *
+ * Deep sparse trie levels take a node per letter for a few words. Here a child
+ * slot of a trie node holds a container: one contiguous buffer with the rest
+ * of every word going through that slot, kept sorted. When a container passes
+ * kBurstEntries words it bursts: a trie node takes its place, with a
+ * container per first letter.
+ *
+ * Containers hold letter indices of the Alphabet, one byte each, not chars:
+ * chars of one letter ('A' and 'a' when folded) are the same there, and byte
+ * order is letter order, the order of trie children.
+ *
+ * Containers are sorted arrays rather than hash tables: a name book needs
+ * prefixes, not only equal words. In order, the word s is the beginning of a
+ * stored word when the first word not less than s begins with s (one binary
+ * search); a stored word t is the beginning of s when t is s cut at its
+ * common prefix with its predecessor in the container (a few searches, each
+ * on a shorter s).
+ */
+
+#ifndef BURST_TREE_H_
+#define BURST_TREE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "tree_alphabet.h"
+#include "word_tree.h"
+
+//! Words in a container before it bursts into a trie node
+constexpr size_t kBurstEntries = 128;
+
+/**
+ * \brief Sorted contiguous set of words (a burst trie container)
+ *
+ * Words are compared byte by byte; BasicBurstTree stores them as letter
+ * indices.
+ */
+class BurstContainer {
+ public:
+  /**
+   * \brief Add word, checking prefix collisions within the container
+   * \param word Word (rest of it below the container slot)
+   * \return kOK; KCollision if word begins with a word in the container, or
+   *         a word in the container begins with it (same word included)
+   */
+  TreeRetCode Add(std::string_view word) {
+    TreeRetCode ret = TreeRetCode::kOK;
+
+    const size_t pos = LowerBound(word);
+    const bool found = pos < entries_.size() && Word(pos) == word;
+    if ((pos < entries_.size() && StartsWith(Word(pos), word)) ||
+        HasPrefixOf(word, pos)) {
+      ret = TreeRetCode::KCollision;
+    }
+
+    if (!found) {
+      entries_.insert(entries_.begin() + static_cast<ptrdiff_t>(pos),
+                      Entry{static_cast<uint32_t>(chars_.size()),
+                            static_cast<uint32_t>(word.size())});
+      chars_.append(word.data(), word.size());
+    }
+
+    return ret;
+  }
+
+  /**
+   * \brief Add a word greater than all in the container (no checks)
+   */
+  void Append(std::string_view word) {
+    assert(entries_.empty() || Word(entries_.size() - 1) < word);
+    entries_.push_back(Entry{static_cast<uint32_t>(chars_.size()),
+                             static_cast<uint32_t>(word.size())});
+    chars_.append(word.data(), word.size());
+  }
+
+  //! Number of words
+  size_t size() const { return entries_.size(); }
+
+  /**
+   * \brief Get a word in order
+   * \param i Index (0 is the least word)
+   * \return Word (valid until the container changes)
+   */
+  std::string_view Word(size_t i) const {
+    return std::string_view(chars_.data() + entries_[i].offset,
+                            entries_[i].length);
+  }
+
+ private:
+  /**
+   * \brief Word of the chars buffer
+   */
+  struct Entry {
+    uint32_t offset;  //!< First char in chars_
+    uint32_t length;  //!< Number of chars
+  };
+
+  static bool StartsWith(std::string_view s, std::string_view prefix) {
+    return s.substr(0, prefix.size()) == prefix;
+  }
+
+  /**
+   * \brief Index of the first word not less than word
+   */
+  size_t LowerBound(std::string_view word) const {
+    size_t lo = 0;
+    size_t hi = entries_.size();
+    while (lo < hi) {
+      const size_t mid = lo + (hi - lo) / 2;
+      if (Word(mid) < word) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    return lo;
+  }
+
+  /**
+   * \brief Check if a word in the container is a proper beginning of word
+   *
+   * A stored t beginning word is less than word, and so is everything between
+   * them, all beginning with t: t also begins the predecessor p. So t begins
+   * the common prefix of word and p; search again on it until none is left.
+   *
+   * \param word Word
+   * \param pos LowerBound(word)
+   * \return true if found; false otherwise
+   */
+  bool HasPrefixOf(std::string_view word, size_t pos) const {
+    while (pos > 0) {
+      const std::string_view p = Word(pos - 1);
+      if (StartsWith(word, p)) {
+        return true;
+      }
+      const size_t common =
+          std::mismatch(p.begin(), p.end(), word.begin(), word.end()).first -
+          p.begin();
+      word = word.substr(0, common);
+      pos = LowerBound(word);
+      if (pos < entries_.size() && Word(pos) == word) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  std::vector<Entry> entries_;  //!< Words in order
+  std::string chars_;           //!< Chars of all words, in adding order
+};
+
+/**
+ * \brief BurstTree class
+ *
+ * Same AddWord() rule and return codes as BasicWordTree of the same Alphabet.
+ */
+template <typename Alphabet>
+class BasicBurstTree {
+  static_assert(Alphabet::kSize <= 256,
+                "containers hold a letter index per byte");
+
+ public:
+  using Letters = Alphabet;  //!< Alphabet of words
+
+  /**
+   * \brief Default constructor
+   */
+  BasicBurstTree() : nodes_(1) {}
+
+  /**
+   * \brief Add word to tree
+   *
+   * A collision is reported when the word begins with a word already in the
+   * tree, or a word already in the tree begins with it.
+   *
+   * \param word Word
+   * \return TreeRetCode; on kInvalidChar the tree is left untouched
+   */
+  TreeRetCode AddWord(std::string_view word) {
+    if (!IsValidWord(word)) {
+      return TreeRetCode::kInvalidChar;
+    }
+
+    // letter indices from here on
+    letters_.resize(word.size());
+    for (size_t i = 0; i < word.size(); ++i) {
+      letters_[i] = static_cast<char>(
+          Alphabet::kIndex[static_cast<unsigned char>(word[i])]);
+    }
+    word = letters_;
+
+    TreeRetCode ret = TreeRetCode::kOK;
+    uint32_t node = kRoot;
+    for (size_t depth = 0;; ++depth) {
+      TrieNode &n = nodes_[node];
+      if (depth == word.size()) {
+        // same word again, or word is the beginning of another one
+        if (n.terminal || n.num_children > 0) {
+          ret = TreeRetCode::KCollision;
+        }
+        n.terminal = true;
+        return ret;
+      }
+      // passing by the end of another word is a collision
+      if (n.terminal) {
+        ret = TreeRetCode::KCollision;
+      }
+
+      const uint32_t index = static_cast<unsigned char>(word[depth]);
+      const uint32_t child = n.children[index];
+      const std::string_view rest = word.substr(depth + 1);
+      if (child == kNone) {
+        nodes_[node].children[index] = NewContainer();
+        ++nodes_[node].num_children;
+        containers_.back().Append(rest);
+        return ret;
+      }
+      if (IsContainer(child)) {
+        BurstContainer &c = containers_[child >> 1];
+        if (c.Add(rest) == TreeRetCode::KCollision) {
+          ret = TreeRetCode::KCollision;
+        }
+        if (c.size() > kBurstEntries) {
+          Burst(node, index);
+        }
+        return ret;
+      }
+      node = child >> 1;
+    }
+  }
+
+  /**
+   * \brief Replace the tree by the given words
+   *
+   * Words in sorted order only ever go to the end of their container.
+   *
+   * \param words Words sorted by SortWords<Alphabet>() (std::string_view
+   *        convertible)
+   * \return KCollision if any word begins another (same word included);
+   *         otherwise kInvalidChar if any word was skipped for invalid chars;
+   *         otherwise kOK
+   */
+  template <typename Range>
+  TreeRetCode BuildFromSorted(const Range &words) {
+    Clear();
+
+    return ForEachSortedWord<Alphabet>(words, IsValidWord,
+                                       [this](std::string_view word, size_t) {
+                                         AddWord(word);
+                                       });
+  }
+
+  /**
+   * \brief Remove all words from tree
+   */
+  void Clear() {
+    nodes_.assign(1, TrieNode());
+    containers_.clear();
+  }
+
+  //! Number of trie nodes (root included)
+  size_t num_nodes() const { return nodes_.size(); }
+
+  //! Number of containers
+  size_t num_containers() const { return containers_.size(); }
+
+ private:
+  static constexpr uint32_t kRoot = 0;  //!< Root node index
+  static constexpr uint32_t kNone = 0;  //!< Empty child (root is no child)
+
+  /**
+   * \brief Trie node; a child is a node index << 1, or a container index << 1
+   *        | 1
+   */
+  struct TrieNode {
+    uint32_t children[Alphabet::kSize] = {};  //!< Children; kNone if none
+    uint16_t num_children = 0;                //!< Children not kNone
+    bool terminal = false;                    //!< A word ends here
+  };
+
+  static bool IsContainer(uint32_t child) { return (child & 1) != 0; }
+
+  /**
+   * \brief Check if all chars of a word are letters of the alphabet
+   */
+  static bool IsValidWord(std::string_view word) {
+    for (const char c : word) {
+      if (Alphabet::kIndex[static_cast<unsigned char>(c)] == kNotInAlphabet) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Add an empty container
+   * \return Child reference
+   */
+  uint32_t NewContainer() {
+    containers_.emplace_back();
+    return static_cast<uint32_t>(containers_.size() - 1) << 1 | 1;
+  }
+
+  /**
+   * \brief Replace a container by a trie node with a container per letter
+   * \param node Parent node index
+   * \param index Letter index of the container in the parent
+   */
+  void Burst(uint32_t node, uint32_t index) {
+    BurstContainer full;
+    uint32_t spare = nodes_[node].children[index];
+    std::swap(full, containers_[spare >> 1]);
+
+    const uint32_t burst = static_cast<uint32_t>(nodes_.size());
+    nodes_.emplace_back();
+    nodes_[node].children[index] = burst << 1;
+
+    // words come in order: each one goes after the others of its letter;
+    // the first new container takes the slot of the burst one
+    for (size_t i = 0; i < full.size(); ++i) {
+      const std::string_view w = full.Word(i);
+      TrieNode &n = nodes_[burst];
+      if (w.empty()) {
+        n.terminal = true;
+        continue;
+      }
+      uint32_t &child = n.children[static_cast<uint8_t>(w[0])];
+      if (child == kNone) {
+        child = spare != kNone ? spare : NewContainer();
+        spare = kNone;
+        ++n.num_children;
+      }
+      containers_[child >> 1].Append(w.substr(1));
+    }
+  }
+
+  std::vector<TrieNode> nodes_;             //!< Trie nodes; root first
+  std::vector<BurstContainer> containers_;  //!< Containers
+  std::string letters_;  //!< Letter indices of the word being added
+};
+
+/**
+ * \brief Burst tree of lowercase words (the name book rule)
+ */
+using BurstTree = BasicBurstTree<AlphabetLower>;
+
+#endif  // BURST_TREE_H_
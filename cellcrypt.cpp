@@ -0,0 +1,255 @@
+/**
+ * \brief Cellcrypt C interface
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#include "cellcrypt.h"
+
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "big_num.h"
+#if defined(CELLCRYPT_WITH_GMP)
+#include "big_num_gmp.h"
+#endif
+#include "name_book_list.h"
+#include "name_book_tree.h"
+
+struct cellcrypt_big_num {
+  BigNum big_num;  //!< Wrapped big number
+};
+
+struct cellcrypt_name_book {
+  std::variant<NameBookList, NameBookTree> name_book;  //!< Wrapped engine
+
+  template <typename T>
+  explicit cellcrypt_name_book(std::in_place_type_t<T> t) : name_book(t) {}
+};
+
+namespace {
+
+/**
+ * \brief Run function, turning exceptions into a status
+ * \param fn Function returning cellcrypt_status
+ * \return Status from fn; CELLCRYPT_ERROR_OUT_OF_MEMORY on std::bad_alloc,
+ *         CELLCRYPT_ERROR_INTERNAL on any other exception
+ */
+template <typename Fn>
+cellcrypt_status Guard(Fn &&fn) {
+  try {
+    return fn();
+  } catch (const std::bad_alloc &) {
+    return CELLCRYPT_ERROR_OUT_OF_MEMORY;
+  } catch (...) {
+    return CELLCRYPT_ERROR_INTERNAL;
+  }
+}
+
+/**
+ * \brief Create handle, turning exceptions into a null handle
+ * \param fn Function returning a new handle
+ * \return Handle from fn; nullptr if it threw
+ */
+template <typename Fn>
+auto Create(Fn &&fn) -> decltype(fn()) {
+  try {
+    return fn();
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+#if defined(CELLCRYPT_WITH_GMP)
+using FactorialNum = GmpBigNum;  //!< Number type of one-shot factorial calls
+#else
+using FactorialNum = BigNum;  //!< Number type of one-shot factorial calls
+#endif
+
+/**
+ * \brief Write big number as null terminated string
+ */
+template <typename Num>
+cellcrypt_status WriteChars(const Num &big_num, char *buf, size_t buf_len,
+                            size_t *required) {
+  const size_t needed = big_num.num_digits() + 1;
+  if (required != nullptr) {
+    *required = needed;
+  }
+  if (buf == nullptr || buf_len < needed) {
+    return CELLCRYPT_ERROR_BUFFER_TOO_SMALL;
+  }
+
+  buf[big_num.ToChars(buf, buf_len)] = '\0';
+
+  return CELLCRYPT_OK;
+}
+
+}  // namespace
+
+extern "C" {
+
+uint32_t cellcrypt_abi_version(void) { return CELLCRYPT_ABI_VERSION; }
+
+cellcrypt_big_num *cellcrypt_big_num_create(uint64_t value) {
+  return Create([&] { return new cellcrypt_big_num{BigNum(value)}; });
+}
+
+void cellcrypt_big_num_destroy(cellcrypt_big_num *big_num) {
+  delete big_num;
+}
+
+cellcrypt_status cellcrypt_big_num_mul(cellcrypt_big_num *big_num,
+                                       uint64_t num) {
+  if (big_num == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    big_num->big_num *= num;
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_status cellcrypt_big_num_factorial(cellcrypt_big_num *big_num,
+                                             uint64_t num) {
+  if (big_num == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    big_num->big_num = factorial(num);
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_status cellcrypt_big_num_num_digits(const cellcrypt_big_num *big_num,
+                                              size_t *num_digits) {
+  if (big_num == nullptr || num_digits == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    *num_digits = big_num->big_num.num_digits();
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_status cellcrypt_big_num_to_chars(const cellcrypt_big_num *big_num,
+                                            char *buf, size_t buf_len,
+                                            size_t *required) {
+  if (big_num == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return WriteChars(big_num->big_num, buf, buf_len, required);
+}
+
+cellcrypt_status cellcrypt_big_num_sum_of_digits(
+    const cellcrypt_big_num *big_num, uint64_t *sum) {
+  if (big_num == nullptr || sum == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    *sum = sum_of_digits(big_num->big_num);
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_status cellcrypt_factorial_to_chars(uint64_t num, char *buf,
+                                              size_t buf_len,
+                                              size_t *required) {
+  return Guard([&] {
+    return WriteChars(factorial<FactorialNum>(num), buf, buf_len, required);
+  });
+}
+
+cellcrypt_status cellcrypt_factorial_sum_of_digits(uint64_t num,
+                                                   uint64_t *sum) {
+  if (sum == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    *sum = sum_of_digits(factorial<FactorialNum>(num));
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_name_book *cellcrypt_name_book_create(
+    cellcrypt_name_book_engine engine) {
+  switch (engine) {
+    case CELLCRYPT_NAME_BOOK_LIST:
+      return Create([] {
+        return new cellcrypt_name_book(std::in_place_type<NameBookList>);
+      });
+    case CELLCRYPT_NAME_BOOK_TREE:
+      return Create([] {
+        return new cellcrypt_name_book(std::in_place_type<NameBookTree>);
+      });
+  }
+
+  return nullptr;
+}
+
+void cellcrypt_name_book_destroy(cellcrypt_name_book *name_book) {
+  delete name_book;
+}
+
+cellcrypt_status cellcrypt_name_book_add_name(cellcrypt_name_book *name_book,
+                                              const char *name,
+                                              size_t name_len) {
+  if (name_book == nullptr || (name == nullptr && name_len > 0)) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    const std::string_view s(name == nullptr ? "" : name, name_len);
+
+    if (auto *list = std::get_if<NameBookList>(&name_book->name_book)) {
+      return list->AddName(s) ? CELLCRYPT_OK : CELLCRYPT_ERROR_COLLISION;
+    }
+
+    switch (std::get<NameBookTree>(name_book->name_book).AddName(s)) {
+      case TreeRetCode::kOK:
+        return CELLCRYPT_OK;
+      case TreeRetCode::KCollision:
+        return CELLCRYPT_ERROR_COLLISION;
+      case TreeRetCode::kInvalidChar:
+        break;
+    }
+
+    return CELLCRYPT_ERROR_INVALID_CHAR;
+  });
+}
+
+cellcrypt_status cellcrypt_name_book_consistent(
+    const cellcrypt_name_book *name_book, int *consistent) {
+  if (name_book == nullptr || consistent == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    *consistent = std::visit(
+        [](const auto &book) { return book.consistent() ? 1 : 0; },
+        name_book->name_book);
+    return CELLCRYPT_OK;
+  });
+}
+
+cellcrypt_status cellcrypt_name_book_clear(cellcrypt_name_book *name_book) {
+  if (name_book == nullptr) {
+    return CELLCRYPT_ERROR_INVALID_ARGUMENT;
+  }
+
+  return Guard([&] {
+    std::visit([](auto &book) { book.ClearNames(); }, name_book->name_book);
+    return CELLCRYPT_OK;
+  });
+}
+
+}  // extern "C"
@@ -0,0 +1,173 @@
+/**
+ * \brief Cellcrypt C interface
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * C interface to the factorial and name book engines, to be linked into C (or
+ * any FFI capable) programs without spawning the interactive executables.
+ *
+ * - All objects are opaque handles created and destroyed by the library;
+ * - Output is written to caller provided buffers, never allocated for caller;
+ * - No function reads from or writes to the standard streams;
+ * - No C++ exception crosses this interface.
+ */
+
+#ifndef CELLCRYPT_H_
+#define CELLCRYPT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CELLCRYPT_ABI_VERSION 1  //!< Bumped on incompatible changes
+
+/**
+ * \brief Marks the interface functions: the library is built with
+ *        -fvisibility=hidden, so these are the only symbols it exports
+ */
+#if defined(__GNUC__)
+#define CELLCRYPT_API __attribute__((visibility("default")))
+#else
+#define CELLCRYPT_API
+#endif
+
+/**
+ * \brief Return codes
+ */
+typedef enum cellcrypt_status {
+  CELLCRYPT_OK = 0,
+  CELLCRYPT_ERROR_INVALID_ARGUMENT = -1,  //!< Null handle or bad value
+  CELLCRYPT_ERROR_BUFFER_TOO_SMALL = -2,  //!< See required size out param
+  CELLCRYPT_ERROR_OUT_OF_MEMORY = -3,
+  CELLCRYPT_ERROR_COLLISION = -4,     //!< Name begins with another name
+  CELLCRYPT_ERROR_INVALID_CHAR = -5,  //!< Name not accepted by engine
+  CELLCRYPT_ERROR_INTERNAL = -6,      //!< Unexpected failure in library
+} cellcrypt_status;
+
+/**
+ * \brief Name book engines
+ */
+typedef enum cellcrypt_name_book_engine {
+  CELLCRYPT_NAME_BOOK_LIST = 0,  //!< Any bytes; O(n) check per name added
+  CELLCRYPT_NAME_BOOK_TREE = 1,  //!< Letters 'a'-'z' only; O(length) check
+} cellcrypt_name_book_engine;
+
+typedef struct cellcrypt_big_num cellcrypt_big_num;
+typedef struct cellcrypt_name_book cellcrypt_name_book;
+
+/**
+ * \brief Get ABI version of the loaded library
+ * \return CELLCRYPT_ABI_VERSION the library was built with
+ */
+CELLCRYPT_API uint32_t cellcrypt_abi_version(void);
+
+/**
+ * \brief Create big number
+ * \param value Initial value
+ * \return Handle; NULL when out of memory
+ */
+CELLCRYPT_API cellcrypt_big_num *cellcrypt_big_num_create(uint64_t value);
+
+/**
+ * \brief Destroy big number (NULL is ignored)
+ */
+CELLCRYPT_API void cellcrypt_big_num_destroy(cellcrypt_big_num *big_num);
+
+/**
+ * \brief Multiply big number by a number in place
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_big_num_mul(
+    cellcrypt_big_num *big_num, uint64_t num);
+
+/**
+ * \brief Replace big number value by the factorial of num
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_big_num_factorial(
+    cellcrypt_big_num *big_num, uint64_t num);
+
+/**
+ * \brief Get number of decimal digits
+ * \param num_digits Out: digits
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_big_num_num_digits(
+    const cellcrypt_big_num *big_num, size_t *num_digits);
+
+/**
+ * \brief Write decimal digits as a null terminated string
+ * \param buf Output buffer
+ * \param buf_len Size of buf; at least num_digits + 1
+ * \param required Optional out: size needed including the terminating null
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_big_num_to_chars(
+    const cellcrypt_big_num *big_num, char *buf, size_t buf_len,
+    size_t *required);
+
+/**
+ * \brief Get sum of decimal digits
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_big_num_sum_of_digits(
+    const cellcrypt_big_num *big_num, uint64_t *sum);
+
+/**
+ * \brief Write factorial of num as a null terminated string
+ * \param required Optional out: size needed including the terminating null
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_factorial_to_chars(uint64_t num,
+                                                            char *buf,
+                                                            size_t buf_len,
+                                                            size_t *required);
+
+/**
+ * \brief Get sum of decimal digits of factorial of num
+ */
+CELLCRYPT_API cellcrypt_status
+cellcrypt_factorial_sum_of_digits(uint64_t num, uint64_t *sum);
+
+/**
+ * \brief Create empty name book
+ * \return Handle; NULL when out of memory or unknown engine
+ */
+CELLCRYPT_API cellcrypt_name_book *cellcrypt_name_book_create(
+    cellcrypt_name_book_engine engine);
+
+/**
+ * \brief Destroy name book (NULL is ignored)
+ */
+CELLCRYPT_API void cellcrypt_name_book_destroy(cellcrypt_name_book *name_book);
+
+/**
+ * \brief Add name to name book
+ *
+ * A name that collides is still added (and book becomes inconsistent); a name
+ * with an invalid char is not.
+ *
+ * \param name Name bytes (need not be null terminated)
+ * \param name_len Size of name
+ * \return CELLCRYPT_OK, CELLCRYPT_ERROR_COLLISION, or an error
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_name_book_add_name(
+    cellcrypt_name_book *name_book, const char *name, size_t name_len);
+
+/**
+ * \brief Check if name book is consistent
+ * \param consistent Out: 1 if consistent; 0 otherwise
+ */
+CELLCRYPT_API cellcrypt_status cellcrypt_name_book_consistent(
+    const cellcrypt_name_book *name_book, int *consistent);
+
+/**
+ * \brief Remove all names from name book
+ */
+CELLCRYPT_API cellcrypt_status
+cellcrypt_name_book_clear(cellcrypt_name_book *name_book);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#endif  // CELLCRYPT_H_
@@ -0,0 +1,218 @@
+/**
+ * \brief Cellcrypt runtime CPU dispatch
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Hot kernels are compiled for several instruction sets in the same binary;
+ * the best one the running CPU supports is picked once, on first use, and
+ * called through a table of function pointers. No build flag is needed.
+ *
+ * - scalar: any x86-64 (or other) CPU;
+ * - avx2: AVX2;
+ * - avx512: AVX-512 F, DQ and BW.
+ *
+ * BigNum by BigNum kernels (Comba, limb add and subtract) are carry chains,
+ * not SIMD: on the avx2 and avx512 paths they run on mulx / adcx / adox when
+ * the CPU also has BMI2 and ADX, and the path name gets "+adx" (Comba x1.2
+ * to x2 past 32 limbs, add and subtract x1.5 to x2; see big_num_bench
+ * kernels). Karatsuba is not dispatched itself: it runs on them, about x1.1
+ * on a 20000 limb product. Adding a carry (LimbsAddCarry()) is not either:
+ * it stops at the first limb below base - 1. Nor is formatting: no SIMD
+ * version beat LimbsFormatScalar().
+ *
+ * CELLCRYPT_CPU_PATH=scalar|avx2 forces a lower path (e.g. to compare paths on
+ * the same machine); a path the CPU lacks is never picked.
+ */
+
+#ifndef CPU_DISPATCH_H_
+#define CPU_DISPATCH_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "limb_kernels.h"
+#include "text_kernels.h"
+
+/**
+ * \brief Instruction set paths
+ */
+enum class CpuPath { kScalar, kAvx2, kAvx512 };
+
+/**
+ * \brief Table of dispatched kernels
+ */
+struct CpuKernels {
+  CpuPath path;      //!< Path kernels were picked for
+  const char *name;  //!< Path name
+
+  //! r = a * m; returns carry limb
+  uint64_t (*mul_small)(uint64_t *r, const uint64_t *a, size_t n, uint64_t m);
+  //! Sum of decimal digits of limbs
+  uint64_t (*digit_sum)(const uint64_t *a, size_t n);
+  //! Index of first white space
+  size_t (*find_space)(const char *p, size_t n);
+  //! Index of first char that is not white space
+  size_t (*find_non_space)(const char *p, size_t n);
+  //! Length of common prefix
+  size_t (*common_prefix)(const char *a, const char *b, size_t n);
+  //! Masks of 64 bytes equal to each of three chars
+  void (*char_masks3)(const char *p, const char c[3], uint64_t masks[3]);
+  //! r = a + b; returns carry (0 or 1)
+  uint64_t (*add)(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n);
+  //! r = a - b; returns borrow (0 or 1)
+  uint64_t (*sub)(uint64_t *r, const uint64_t *a, const uint64_t *b, size_t n);
+  //! r = a * b, column by column (n + m limbs out)
+  void (*mul_comba)(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b,
+                    size_t m);
+};
+
+/**
+ * \brief Get best path supported by this CPU
+ * \return Path
+ */
+inline CpuPath DetectCpuPath() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq") &&
+      __builtin_cpu_supports("avx512bw")) {
+    return CpuPath::kAvx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return CpuPath::kAvx2;
+  }
+#endif
+
+  return CpuPath::kScalar;
+}
+
+/**
+ * \brief Check if this CPU has BMI2 and ADX (mulx, adcx, adox)
+ * \return true if it has both; false otherwise
+ */
+inline bool DetectCpuAdx() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("adx");
+#else
+  return false;
+#endif
+}
+
+/**
+ * \brief Build kernel table for a path
+ * \param path Path (must be supported by this CPU)
+ * \return Kernel table
+ */
+inline CpuKernels MakeCpuKernels(CpuPath path) {
+  CpuKernels k{CpuPath::kScalar,      "scalar",           LimbsMulSmallScalar,
+               LimbsDigitSumScalar,  FindSpaceScalar,    FindNonSpaceScalar,
+               CommonPrefixScalar,   CharMasks3Scalar,   LimbsAddScalar,
+               LimbsSubScalar,       LimbsMulCombaScalar};
+
+#if defined(__x86_64__)
+  const bool adx = path != CpuPath::kScalar && DetectCpuAdx();
+  if (adx) {
+    k.add = LimbsAddAdx;
+    k.sub = LimbsSubAdx;
+    k.mul_comba = LimbsMulCombaAdx;
+  }
+  switch (path) {
+    case CpuPath::kAvx512:
+      k.path = CpuPath::kAvx512;
+      k.name = adx ? "avx512+adx" : "avx512";
+      k.mul_small = LimbsMulSmallAvx512;
+      k.digit_sum = LimbsDigitSumAvx2;
+      k.find_space = FindSpaceAvx512;
+      k.find_non_space = FindNonSpaceAvx512;
+      k.common_prefix = CommonPrefixAvx512;
+      k.char_masks3 = CharMasks3Avx512;
+      break;
+    case CpuPath::kAvx2:
+      k.path = CpuPath::kAvx2;
+      k.name = adx ? "avx2+adx" : "avx2";
+      k.mul_small = LimbsMulSmallAvx2;
+      k.digit_sum = LimbsDigitSumAvx2;
+      k.find_space = FindSpaceAvx2;
+      k.find_non_space = FindNonSpaceAvx2;
+      k.common_prefix = CommonPrefixAvx2;
+      k.char_masks3 = CharMasks3Avx2;
+      break;
+    case CpuPath::kScalar:
+      break;
+  }
+#else
+  (void)path;
+#endif
+
+  return k;
+}
+
+/**
+ * \brief Pick path: detected one, lowered by CELLCRYPT_CPU_PATH if set
+ * \return Path
+ */
+inline CpuPath SelectCpuPath() {
+  CpuPath path = DetectCpuPath();
+
+  const char *forced = std::getenv("CELLCRYPT_CPU_PATH");
+  if (forced != nullptr) {
+    if (std::strcmp(forced, "scalar") == 0) {
+      path = CpuPath::kScalar;
+    } else if (std::strcmp(forced, "avx2") == 0 && path > CpuPath::kAvx2) {
+      path = CpuPath::kAvx2;
+    }
+  }
+
+  return path;
+}
+
+/**
+ * \brief Get kernel table for this CPU (picked on first call)
+ * \return Kernel table
+ */
+inline const CpuKernels &cpu_kernels() {
+  static const CpuKernels kernels = MakeCpuKernels(SelectCpuPath());
+  return kernels;
+}
+
+/**
+ * \brief r = a * m, on best path for this CPU
+ * \return Carry out limb (may be >= base when m >= base)
+ */
+inline uint64_t LimbsMulSmall(uint64_t *r, const uint64_t *a, size_t n,
+                              uint64_t m) {
+  return cpu_kernels().mul_small(r, a, n, m);
+}
+
+/**
+ * \brief r = a + b, on best path for this CPU
+ * \return Carry out (0 or 1)
+ */
+inline uint64_t LimbsAdd(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                         size_t n) {
+  return cpu_kernels().add(r, a, b, n);
+}
+
+/**
+ * \brief r = a - b, on best path for this CPU
+ * \return Borrow out (0 or 1)
+ */
+inline uint64_t LimbsSub(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                         size_t n) {
+  return cpu_kernels().sub(r, a, b, n);
+}
+
+/**
+ * \brief r = a * b column by column (Comba), on best path for this CPU
+ * \param r Output of n + m limbs (must not overlap a or b)
+ */
+inline void LimbsMulComba(uint64_t *r, const uint64_t *a, size_t n,
+                          const uint64_t *b, size_t m) {
+  cpu_kernels().mul_comba(r, a, n, b, m);
+}
+
+#endif  // CPU_DISPATCH_H_
@@ -0,0 +1,106 @@
+/**
+ * \brief Cellcrypt factorial digit sum table
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Digit sums of n! for every n in [0, N].
+ *
+ * [0, N] is cut into segments of about the same work (a step costs about the
+ * digits of n!, so upper segments are shorter). Each segment is seeded with
+ * range_product() for factorial(start) and then extended one multiply by word
+ * per step, digit summing every step. Threads take segments from a shared
+ * counter; there are several segments per thread so none is left waiting on a
+ * long one.
+ */
+
+#ifndef DIGIT_SUM_TABLE_H_
+#define DIGIT_SUM_TABLE_H_
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "big_num.h"
+
+//! Segments per thread of DigitSumTable()
+constexpr size_t kDigitSumSegmentsPerThread = 8;
+
+/**
+ * \brief Split [0, n_max] into segments of about the same work
+ * \param n_max Last number
+ * \param parts Number of segments
+ * \return Segment starts, followed by n_max + 1
+ */
+inline std::vector<uint64_t> DigitSumSegments(uint64_t n_max, size_t parts) {
+  // step n costs about log10(n!) ~ n * log10(n / e), plus a fixed overhead
+  auto cost = [](uint64_t n) {
+    const double x = static_cast<double>(n);
+    return 1.0 + (n > 2 ? x * (std::log10(x) - 0.4342944819) : 0.0);
+  };
+
+  double total = 0;
+  for (uint64_t n = 0; n <= n_max; ++n) {
+    total += cost(n);
+  }
+
+  std::vector<uint64_t> bounds{0};
+  double done = 0;
+  for (uint64_t n = 0; n <= n_max; ++n) {
+    done += cost(n);
+    if (bounds.size() < parts && done * parts >= total * bounds.size() &&
+        n < n_max) {
+      bounds.push_back(n + 1);
+    }
+  }
+  bounds.push_back(n_max + 1);
+
+  return bounds;
+}
+
+/**
+ * \brief Sum of digits of n! for every n in [0, n_max]
+ * \param n_max Last number
+ * \param threads Number of threads (0 or 1 runs on the calling thread)
+ * \return Table of n_max + 1 sums, indexed by n
+ */
+inline std::vector<uint64_t> DigitSumTable(uint64_t n_max, unsigned threads) {
+  if (threads == 0) {
+    threads = 1;
+  }
+  const std::vector<uint64_t> bounds =
+      DigitSumSegments(n_max, threads * kDigitSumSegmentsPerThread);
+  const size_t segments = bounds.size() - 1;
+
+  std::vector<uint64_t> table(n_max + 1);
+  std::atomic<size_t> next{0};
+
+  auto run = [&] {
+    for (size_t s = next++; s < segments; s = next++) {
+      const uint64_t start = bounds[s];
+      BigNum f = factorial_tree(start);
+      table[start] = sum_of_digits(f);
+      for (uint64_t n = start + 1; n < bounds[s + 1]; ++n) {
+        f *= n;
+        table[n] = sum_of_digits(f);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back(run);
+  }
+  run();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+
+  return table;
+}
+
+#endif  // DIGIT_SUM_TABLE_H_
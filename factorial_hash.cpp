@@ -37,8 +37,10 @@
  * - If memory was really really an issue, the code could be reorganized to be a
  *   single functions to avoid some variables and copies, like the std::vector;
  *
- *  * Obs: I would break the related function on its own library. but kept it
- *         all here for ease of reading.
+ *  * Obs: BigNum and related functions now live on big_num.h, so they can be
+ *         linked into other programs (see cellcrypt.h for the C interface).
+ *  * Obs: input is bounded, so factorial uses FixedBigNum, sized at compile
+ *         time, and never touches the heap.
  *
  * New changes:
  * - Since logic changed, and its a bit more complex, now it makes sense to have
@@ -59,132 +61,127 @@
  * - operator* and operator=* now work with 10^15 base, to make use of uint64_t;
  */
 
-#include <iomanip>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "alloc_profile.h"
+#include "big_num.h"
+#include "big_num_output.h"
+#include "big_num_stats.h"
+#include "digit_sum_table.h"
+#include "factorial_lanes.h"
+#if defined(CELLCRYPT_WITH_GMP)
+#include "big_num_gmp.h"
+#endif
+
 /**
- * \brief Big number class
+ * \brief Print digit sums of n! for every n in [0, n_max]
+ *
+ * CSV has a "n,digit_sum" header and one row per n; binary is the n_max + 1
+ * sums as uint64_t in host byte order, indexed by n.
+ *
+ * \param n_max Last number
+ * \param threads Number of threads
+ * \param binary Binary output instead of CSV
  */
-class BigNum {
- public:
-  /**
-   * \brief Default constructor
-   */
-  BigNum() : big_num_() {}
-
-  /**
-   * \brief Construct from number
-   * \param num Initial value
-   */
-  explicit BigNum(uint64_t num) : big_num_() { big_num_.push_back(num); }
-
-  BigNum operator*(uint64_t num) {
-    BigNum new_big_num(*this);
-
-    uint64_t carry = 0;
-    constexpr uint64_t base = 1000000000000000;
-
-    for (uint64_t i = 0; i < new_big_num.big_num_.size(); ++i) {
-      uint64_t prod = new_big_num.big_num_[i] * num + carry;
-
-      new_big_num.big_num_[i] = prod % base;
-
-      carry = prod / base;
-    }
-
-    while (carry) {
-      new_big_num.big_num_.push_back(carry % base);
-      carry = carry / base;
-    }
-
-    return new_big_num;
+void PrintDigitSumTable(uint64_t n_max, unsigned threads, bool binary) {
+  SetAllocPhase("table");
+  const std::vector<uint64_t> table = DigitSumTable(n_max, threads);
+  SetAllocPhase("output");
+
+  if (binary) {
+    std::cout.write(reinterpret_cast<const char *>(table.data()),
+                    static_cast<std::streamsize>(table.size() *
+                                                 sizeof(uint64_t)));
+    return;
   }
 
-  BigNum &operator*=(uint64_t num) {
-    uint64_t carry = 0;
-
-    constexpr uint64_t base = 1000000000000000;
-    for (uint64_t i = 0; i < big_num_.size(); ++i) {
-      uint64_t prod = big_num_[i] * num + carry;
-
-      big_num_[i] = prod % base;
-
-      std::cout << big_num_[i] << std::endl;
-
-      carry = prod / base;
-    }
-
-    while (carry) {
-      big_num_.push_back(carry % base);
-      carry = carry / base;
-    }
-
-    return *this;
+  std::string out = "n,digit_sum\n";
+  for (uint64_t n = 0; n <= n_max; ++n) {
+    out += std::to_string(n);
+    out += ',';
+    out += std::to_string(table[n]);
+    out += '\n';
   }
-
-  /**
-   * \brief Get big number raw data
-   * \return vector as big number
-   */
-  const std::vector<uint64_t> &big_num_raw() const { return big_num_; }
-
-  // TODO(felipe.bolsi) add other operators!
-
-  friend std::ostream &operator<<(std::ostream &o, const BigNum &big_num);
-
- private:
-  std::vector<uint64_t> big_num_;
-};
+  std::cout << out;
+}
 
 /**
- * \brief Stream output BigNum
- * \return Stream output BigNum
+ * \brief Run Factorial Hash Challenge (see main() for options)
+ * \return 0 on success; -1 on error
  */
-std::ostream &operator<<(std::ostream &o, const BigNum &big_num) {
-  if (!big_num.big_num_.empty()) {
-    for (int32_t i = (big_num.big_num_.size() - 1); i >= 0; --i) {
-      o << std::setw(15) << std::setfill('0') << big_num.big_num_[i];
+int Run(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--print-cpu-path") == 0) {
+    std::cout << cpu_kernels().name << std::endl;
+    return 0;
+  }
+  if (argc > 2 && std::strcmp(argv[1], "--range") == 0) {
+    const uint64_t n_max = std::strtoull(argv[2], nullptr, 10);
+    unsigned threads = std::thread::hardware_concurrency();
+    bool binary = false;
+    for (int i = 3; i < argc; ++i) {
+      if (std::strcmp(argv[i], "--binary") == 0) {
+        binary = true;
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+        threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+      } else {
+        std::cerr << "Unknown option " << argv[i] << std::endl;
+        return -1;
+      }
     }
+    PrintDigitSumTable(n_max, threads, binary);
+    return 0;
   }
 
-  return o;
-}
-
-/**
- * \brief Calculates the factorial of a number
- * \param num Number to calculate factorial
- * \return Factorial of given number
- */
-BigNum factorial(uint64_t num) {
-  BigNum f(1);
+  if (argc > 2 && std::strcmp(argv[1], "--print") == 0) {
+    const uint64_t n = std::strtoull(argv[2], nullptr, 10);
+    unsigned threads = std::thread::hardware_concurrency();
+    const char *out = nullptr;
+    for (int i = 3; i < argc; ++i) {
+      if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+        out = argv[++i];
+      } else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+        threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+      } else {
+        std::cerr << "Unknown option " << argv[i] << std::endl;
+        return -1;
+      }
+    }
 
-  for (uint64_t i = num; i > 0; --i) {
-    f *= i;
+    SetAllocPhase("factorial");
+    const BigNum f = factorial_tree(n);
+    SetAllocPhase("output");
+    const OutputRetCode ret = out != nullptr
+                                  ? WriteDecimalFile(f, out, threads)
+                                  : WriteDecimalFd(f, STDOUT_FILENO, threads);
+    if (ret != OutputRetCode::kOK) {
+      std::cerr << "Could not write factorial of " << n << std::endl;
+      return -1;
+    }
+    return 0;
   }
-
-  return f;
-}
-
-/**
- * \brief Calculates the sum of digits of a number
- * \param big_num Number to calculate the sum
- * \return Sum of digits of given number
- */
-uint64_t sum_of_digits(const BigNum &big_num) {
-  uint64_t sum = 0;
-  for (const uint64_t d : big_num.big_num_raw()) {
-    sum += d;
+  if (argc > 1 && std::strcmp(argv[1], "--batch") == 0) {
+    SetAllocPhase("read");
+    std::vector<uint64_t> queries;
+    for (uint64_t n = 0; std::cin >> n;) {
+      queries.push_back(n);
+    }
+    SetAllocPhase("digit sums");
+    const std::vector<uint64_t> sums = FactorialDigitSums(queries);
+    SetAllocPhase("output");
+    std::string out;
+    for (const uint64_t sum : sums) {
+      out += std::to_string(sum);
+      out += '\n';
+    }
+    std::cout << out;
+    return 0;
   }
 
-  return sum;
-}
-
-/**
- * \brief Entry point of Factorial Hash Challenge
- * \return 0 on success; -1 on error
- */
-int main() {
   const uint32_t kUpperBound = 2000;
   std::cout << "Enter a number within range [0," << kUpperBound << "]: ";
 
@@ -197,7 +194,15 @@ int main() {
     return -1;
   }
 
-  BigNum f_big_num = factorial(x);
+  SetAllocPhase("factorial");
+#if defined(CELLCRYPT_WITH_GMP)
+  const auto f_big_num = factorial<GmpBigNum>(x);
+#else
+  // bounded input: number lives on the stack, no allocation
+  const auto f_big_num =
+      factorial<FixedBigNum<FactorialLimbsBound(kUpperBound)>>(x);
+#endif
+  SetAllocPhase("output");
   std::cout << "Factorial of " << x << " = " << f_big_num << std::endl;
 
   uint64_t digit_sum = sum_of_digits(f_big_num);
@@ -206,3 +211,47 @@ int main() {
 
   return 0;
 }
+
+/**
+ * \brief Entry point of Factorial Hash Challenge
+ *
+ * --print-cpu-path prints the instruction set path picked for this CPU.
+ * --range N [--threads T] [--binary] prints digit sums of n! for all n in
+ * [0, N] (no upper bound) as CSV or binary.
+ * Built with -DCELLCRYPT_WITH_GMP (and -lgmp), the single factorial comes
+ * from GMP instead of BigNum.
+ * --print N [--out FILE] [--threads T] writes N! in decimal (no upper bound):
+ * formatted by T threads straight into the mmapped FILE, or to stdout (pages
+ * handed over with vmsplice when stdout is a pipe).
+ * --batch reads numbers from stdin until end of input and prints the digit sum
+ * of each factorial, one per line, computed kFactorialLanes at a time.
+ * --stats (anywhere, with any of the above) prints BigNum memory and operation
+ * counters to stderr at the end; built with -DCELLCRYPT_STATS only.
+ * Built with -DCELLCRYPT_ALLOC_PROFILE, heap allocations of every phase and
+ * their top call sites are printed to stderr at the end.
+ *
+ * \return 0 on success; -1 on error
+ */
+int main(int argc, char **argv) {
+  bool stats = false;
+  int args = 0;
+  for (int i = 0; i < argc; ++i) {
+    if (i > 0 && std::strcmp(argv[i], "--stats") == 0) {
+      stats = true;
+    } else {
+      argv[args++] = argv[i];
+    }
+  }
+
+  const int ret = Run(args, argv);
+  PrintAllocProfile(std::cerr);
+  if (stats) {
+    if (kBigNumStats) {
+      std::cerr << big_num_stats();
+    } else {
+      std::cerr << "--stats needs a build with -DCELLCRYPT_STATS" << std::endl;
+    }
+  }
+
+  return ret;
+}
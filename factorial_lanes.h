@@ -0,0 +1,283 @@
+/**
+ * \brief Cellcrypt multi-lane factorial engine
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Digit sums of n! for many small n at once.
+ *
+ * kFactorialLanes factorials are computed side by side, one per lane, on base
+ * 10^9 limbs: limb i of every lane is one row, so a row is two AVX2 vectors
+ * and a multiply by word is a walk over rows with 32 x 32 -> 64 bit products,
+ * lanes in lockstep. Every step multiplies each lane by its next two factors
+ * (one above kLanePairMax; 1 once the lane is done), keeping products below
+ * 2^52 so a double divides them exactly; the row count follows the largest
+ * lane. Queries
+ * are sorted first so lanes of a batch have close n.
+ *
+ * Single n or large n are better served by factorial() on BigNum.
+ */
+
+#ifndef FACTORIAL_LANES_H_
+#define FACTORIAL_LANES_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "big_num.h"
+
+constexpr size_t kFactorialLanes = 8;       //!< Factorials per batch
+constexpr uint64_t kLaneBase = 1000000000;  //!< Lane limb base (10^9)
+constexpr uint64_t kLaneMulMax = (1 << 22) - 1;  //!< Largest lane multiplier
+constexpr uint64_t kLanePairMax = 2047;  //!< Factors paired up to here (< 2^22)
+constexpr uint64_t kFactorialLanesMax = kLaneMulMax;  //!< Largest n
+
+/**
+ * \brief rows = rows * m, lane by lane
+ * \param x Rows of kFactorialLanes limbs
+ * \param rows Number of rows
+ * \param m Multiplier of each lane (at most kLaneMulMax: products < 2^52)
+ * \param carry Carry out of each lane (at most m)
+ */
+inline void LanesMulSmallScalar(uint64_t *x, size_t rows, const uint64_t *m,
+                                uint64_t *carry) {
+  std::fill(carry, carry + kFactorialLanes, 0);
+  for (size_t i = 0; i < rows; ++i, x += kFactorialLanes) {
+    for (size_t l = 0; l < kFactorialLanes; ++l) {
+      const uint64_t prod = x[l] * m[l] + carry[l];
+      x[l] = prod % kLaneBase;
+      carry[l] = prod / kLaneBase;
+    }
+  }
+}
+
+#if defined(__x86_64__)
+
+/**
+ * \brief Split 4 lanes of p < 2^52 into p / 10^9 and p % 10^9
+ */
+__attribute__((target("avx2"))) inline __m256i LaneDivAvx2(__m256i p,
+                                                           __m256i *rem) {
+  const __m256i base = _mm256_set1_epi64x(kLaneBase);
+  const __m256i base_m1 = _mm256_set1_epi64x(kLaneBase - 1);
+  // a bit below 10^-9: estimate is never above the quotient, at most 1 below
+  const __m256d inv_base = _mm256_set1_pd(1e-9 * (1 - 1.0 / (1ull << 50)));
+
+  __m256i q = DoubleToU52Avx2(
+      _mm256_floor_pd(_mm256_mul_pd(U52ToDoubleAvx2(p), inv_base)));
+  __m256i r = _mm256_sub_epi64(p, _mm256_mul_epu32(q, base));
+  const __m256i big = _mm256_cmpgt_epi64(r, base_m1);
+  r = _mm256_sub_epi64(r, _mm256_and_si256(big, base));
+  q = _mm256_sub_epi64(q, big);  // big is -1
+
+  *rem = r;
+  return q;
+}
+
+/**
+ * \brief rows = rows * m, lane by lane (AVX2, two vectors per row)
+ *
+ * Same contract as LanesMulSmallScalar(). Products are split independently,
+ * so the divisions of all rows overlap; only the add of the quotient of the
+ * row below (q < base, so one compare fixes it) is a chain.
+ */
+__attribute__((target("avx2"))) inline void LanesMulSmallAvx2(
+    uint64_t *x, size_t rows, const uint64_t *m, uint64_t *carry) {
+  static_assert(kFactorialLanes == 8, "two vectors per row");
+  const __m256i base = _mm256_set1_epi64x(kLaneBase);
+  const __m256i base_m1 = _mm256_set1_epi64x(kLaneBase - 1);
+  const __m256i m0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m));
+  const __m256i m1 =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m + 4));
+  // quotient of the row below plus its carry (0 or -1 as a mask)
+  __m256i q0 = _mm256_setzero_si256();
+  __m256i q1 = _mm256_setzero_si256();
+  __m256i c0 = _mm256_setzero_si256();
+  __m256i c1 = _mm256_setzero_si256();
+
+  for (size_t i = 0; i < rows; ++i, x += kFactorialLanes) {
+    __m256i *row = reinterpret_cast<__m256i *>(x);
+    __m256i r0;
+    __m256i r1;
+    const __m256i nq0 =
+        LaneDivAvx2(_mm256_mul_epu32(_mm256_loadu_si256(row), m0), &r0);
+    const __m256i nq1 =
+        LaneDivAvx2(_mm256_mul_epu32(_mm256_loadu_si256(row + 1), m1), &r1);
+
+    __m256i s0 = _mm256_sub_epi64(_mm256_add_epi64(r0, q0), c0);
+    __m256i s1 = _mm256_sub_epi64(_mm256_add_epi64(r1, q1), c1);
+    c0 = _mm256_cmpgt_epi64(s0, base_m1);
+    c1 = _mm256_cmpgt_epi64(s1, base_m1);
+    s0 = _mm256_sub_epi64(s0, _mm256_and_si256(c0, base));
+    s1 = _mm256_sub_epi64(s1, _mm256_and_si256(c1, base));
+    _mm256_storeu_si256(row, s0);
+    _mm256_storeu_si256(row + 1, s1);
+    q0 = nq0;
+    q1 = nq1;
+  }
+
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(carry),
+                      _mm256_sub_epi64(q0, c0));
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(carry + 4),
+                      _mm256_sub_epi64(q1, c1));
+}
+
+/**
+ * \brief rows = rows * m, lane by lane (AVX-512, one vector per row)
+ *
+ * Same contract and split as LanesMulSmallAvx2().
+ */
+__attribute__((target("avx512f,avx512dq"))) inline void LanesMulSmallAvx512(
+    uint64_t *x, size_t rows, const uint64_t *m, uint64_t *carry) {
+  static_assert(kFactorialLanes == 8, "one vector per row");
+  const __m512i base = _mm512_set1_epi64(kLaneBase);
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512d inv_base = _mm512_set1_pd(1e-9 * (1 - 1.0 / (1ull << 50)));
+  const __m512i vm = _mm512_loadu_si512(m);
+  __m512i q_below = _mm512_setzero_si512();
+
+  // maskz_mul_epu32 with a full mask is vpmuludq; plain mul_epu32 trips a
+  // false uninitialized warning on GCC 12
+  for (size_t i = 0; i < rows; ++i, x += kFactorialLanes) {
+    const __m512i p = _mm512_maskz_mul_epu32(0xff, _mm512_loadu_si512(x), vm);
+    __m512i q = _mm512_cvttpd_epu64(
+        _mm512_mul_pd(_mm512_cvtepu64_pd(p), inv_base));
+    __m512i r = _mm512_sub_epi64(p, _mm512_maskz_mul_epu32(0xff, q, base));
+    const __mmask8 big = _mm512_cmpge_epu64_mask(r, base);
+    r = _mm512_mask_sub_epi64(r, big, r, base);
+    q = _mm512_mask_add_epi64(q, big, q, one);
+
+    __m512i s = _mm512_add_epi64(r, q_below);
+    const __mmask8 over = _mm512_cmpge_epu64_mask(s, base);
+    s = _mm512_mask_sub_epi64(s, over, s, base);
+    q_below = _mm512_mask_add_epi64(q, over, q, one);
+    _mm512_storeu_si512(x, s);
+  }
+
+  _mm512_storeu_si512(carry, q_below);
+}
+
+#endif  // defined(__x86_64__)
+
+using LanesMulSmallFn = void (*)(uint64_t *, size_t, const uint64_t *,
+                                 uint64_t *);
+
+/**
+ * \brief Lane multiply kernel for the dispatched CPU path
+ */
+inline LanesMulSmallFn LanesMulSmall() {
+#if defined(__x86_64__)
+  switch (cpu_kernels().path) {
+    case CpuPath::kAvx512:
+      return LanesMulSmallAvx512;
+    case CpuPath::kAvx2:
+      return LanesMulSmallAvx2;
+    default:
+      break;
+  }
+#endif
+  return LanesMulSmallScalar;
+}
+
+/**
+ * \brief Digit sums of n! for up to kFactorialLanes numbers at once
+ * \param n Numbers (each at most kFactorialLanesMax)
+ * \param count Number of numbers (at most kFactorialLanes)
+ * \param sums Digit sum of n[l]! for each l
+ */
+inline void FactorialDigitSumLanes(const uint64_t *n, size_t count,
+                                   uint64_t *sums) {
+  assert(count <= kFactorialLanes);
+  uint64_t lane_n[kFactorialLanes] = {};
+  std::copy(n, n + count, lane_n);
+  const uint64_t n_max = *std::max_element(lane_n, lane_n + kFactorialLanes);
+  assert(n_max <= kFactorialLanesMax);
+
+  const LanesMulSmallFn mul = LanesMulSmall();
+
+  // one row per 9 digits of the largest lane (rows grow as carries come out)
+  std::vector<uint64_t> x(kFactorialLanes);
+  x.reserve(kFactorialLanes * (FactorialLimbsBound<Radix10e9>(n_max) + 2));
+  std::fill(x.begin(), x.end(), 1);
+  size_t rows = 1;
+
+  uint64_t m[kFactorialLanes];
+  uint64_t carry[kFactorialLanes];
+  for (uint64_t f = 2; f <= n_max;) {
+    const uint64_t last = f <= kLanePairMax - 1 ? f + 1 : f;
+    for (size_t l = 0; l < kFactorialLanes; ++l) {
+      m[l] = 1;
+      for (uint64_t i = f; i <= std::min(last, lane_n[l]); ++i) {
+        m[l] *= i;
+      }
+    }
+    f = last + 1;
+    mul(x.data(), rows, m, carry);
+
+    // carries <= base may take 2 rows
+    while (std::any_of(carry, carry + kFactorialLanes,
+                       [](uint64_t c) { return c != 0; })) {
+      for (size_t l = 0; l < kFactorialLanes; ++l) {
+        x.push_back(carry[l] % kLaneBase);
+        carry[l] /= kLaneBase;
+      }
+      ++rows;
+    }
+  }
+
+  for (size_t l = 0; l < count; ++l) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < rows; ++i) {
+      const uint64_t v = x[i * kFactorialLanes + l];
+      sum += kDigitSum4[v % 10000] + kDigitSum4[v / 10000 % 10000] +
+             kDigitSum4[v / 100000000];
+    }
+    sums[l] = sum;
+  }
+}
+
+/**
+ * \brief Digit sums of n! for any number of queries
+ *
+ * Queries are sorted so that each batch of kFactorialLanes has close n and
+ * little lockstep work is wasted; n above kFactorialLanesMax go to BigNum.
+ *
+ * \param n Numbers
+ * \return Digit sum of n[i]! for each i, in the same order
+ */
+inline std::vector<uint64_t> FactorialDigitSums(const std::vector<uint64_t> &n) {
+  std::vector<size_t> order(n.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(),
+            [&](size_t a, size_t b) { return n[a] < n[b]; });
+
+  std::vector<uint64_t> sums(n.size());
+  uint64_t batch[kFactorialLanes];
+  uint64_t batch_sums[kFactorialLanes];
+  for (size_t i = 0; i < order.size(); i += kFactorialLanes) {
+    const size_t count = std::min(kFactorialLanes, order.size() - i);
+    if (n[order[i + count - 1]] > kFactorialLanesMax) {
+      for (size_t j = i; j < i + count; ++j) {
+        sums[order[j]] = sum_of_digits(factorial(n[order[j]]));
+      }
+      continue;
+    }
+
+    for (size_t j = 0; j < count; ++j) {
+      batch[j] = n[order[i + j]];
+    }
+    FactorialDigitSumLanes(batch, count, batch_sums);
+    for (size_t j = 0; j < count; ++j) {
+      sums[order[i + j]] = batch_sums[j];
+    }
+  }
+
+  return sums;
+}
+
+#endif  // FACTORIAL_LANES_H_
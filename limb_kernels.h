@@ -0,0 +1,948 @@
+/**
+ * \brief Cellcrypt big number limb kernels
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef LIMB_KERNELS_H_
+#define LIMB_KERNELS_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * Limb kernels
+ *
+ * Work on raw base 10^15 limbs (least significant first) and never allocate.
+ * Output may alias an input of the same size. Loops are unrolled by 4 so carry
+ * chains of independent limbs can overlap.
+ */
+
+constexpr uint64_t kLimbBase = 1000000000000000;  //!< Limb base (10^15)
+
+/**
+ * \brief Divide 128 bit number by 64 bit number (quotient must fit 64 bits)
+ * \param hi High 64 bits of dividend (must be < d)
+ * \param lo Low 64 bits of dividend
+ * \param d Divisor
+ * \param rem Remainder
+ * \return Quotient
+ */
+inline uint64_t Div128By64(uint64_t hi, uint64_t lo, uint64_t d,
+                           uint64_t *rem) {
+#if defined(__x86_64__)
+  uint64_t q = 0;
+  __asm__("divq %4" : "=a"(q), "=d"(*rem) : "a"(lo), "d"(hi), "rm"(d));
+  return q;
+#else
+  const unsigned __int128 n = (static_cast<unsigned __int128>(hi) << 64) | lo;
+  *rem = static_cast<uint64_t>(n % d);
+  return static_cast<uint64_t>(n / d);
+#endif
+}
+
+/**
+ * \brief Precomputed reciprocal of a divisor (Moller and Granlund, "Improved
+ *        division by invariant integers", 2011)
+ */
+struct Div2By1Inverse {
+  uint64_t d_norm;  //!< Divisor shifted so its top bit is set
+  uint64_t v;       //!< floor((2^128 - 1) / d_norm) - 2^64
+  uint32_t shift;   //!< Left shift applied to divisor
+};
+
+/**
+ * \brief Compute reciprocal of a divisor (at compile time when constant)
+ * \param d Divisor (must not be 0)
+ * \return Reciprocal
+ */
+constexpr Div2By1Inverse MakeDiv2By1Inverse(uint64_t d) {
+  const uint32_t shift = static_cast<uint32_t>(__builtin_clzll(d));
+  const uint64_t d_norm = d << shift;
+  const uint64_t v = static_cast<uint64_t>(
+      ~static_cast<unsigned __int128>(0) / d_norm -
+      (static_cast<unsigned __int128>(1) << 64));
+
+  return {d_norm, v, shift};
+}
+
+/**
+ * \brief Divide 128 bit number by constant D with a reciprocal multiply
+ *
+ * Same contract as Div128By64(); two multiplications instead of a hardware
+ * division, which is faster wherever division is not pipelined.
+ *
+ * \param hi High 64 bits of dividend (must be < D)
+ * \param lo Low 64 bits of dividend
+ * \param rem Remainder
+ * \return Quotient
+ */
+template <uint64_t D>
+inline uint64_t Div128ByConst(uint64_t hi, uint64_t lo, uint64_t *rem) {
+  constexpr Div2By1Inverse kInv = MakeDiv2By1Inverse(D);
+  constexpr uint32_t kShift = kInv.shift;
+
+  // normalize dividend too; (64 - kShift) & 63 keeps the shift defined
+  const uint64_t u1 =
+      kShift == 0 ? hi : (hi << kShift) | (lo >> ((64 - kShift) & 63));
+  const uint64_t u0 = lo << kShift;
+
+  const unsigned __int128 q =
+      static_cast<unsigned __int128>(kInv.v) * u1 +
+      ((static_cast<unsigned __int128>(u1) << 64) | u0);
+  uint64_t q1 = static_cast<uint64_t>(q >> 64) + 1;
+  const uint64_t q0 = static_cast<uint64_t>(q);
+
+  uint64_t r = u0 - q1 * kInv.d_norm;
+  // estimate is often one too big when the normalized divisor is far from
+  // 2^64 (e.g. 10^19): then a branch mispredicts and masks are faster
+  if constexpr (kInv.d_norm < 0xc000000000000000) {
+    const uint64_t mask = 0 - static_cast<uint64_t>(r > q0);
+    q1 += mask;
+    r += mask & kInv.d_norm;
+  } else if (r > q0) {
+    --q1;
+    r += kInv.d_norm;
+  }
+  if (__builtin_expect(r >= kInv.d_norm, 0)) {
+    ++q1;
+    r -= kInv.d_norm;
+  }
+
+  *rem = r >> kShift;
+  return q1;
+}
+
+/**
+ * \brief Add one limb with carry
+ * \param a Limb
+ * \param b Limb
+ * \param carry Carry in/out (0 or 1)
+ * \return Sum limb
+ */
+inline uint64_t LimbAdd(uint64_t a, uint64_t b, uint64_t *carry) {
+  const uint64_t s = a + b + *carry;
+  *carry = s >= kLimbBase;
+  return s - (*carry ? kLimbBase : 0);
+}
+
+/**
+ * \brief Subtract one limb with borrow
+ * \param a Limb
+ * \param b Limb
+ * \param borrow Borrow in/out (0 or 1)
+ * \return Difference limb
+ */
+inline uint64_t LimbSub(uint64_t a, uint64_t b, uint64_t *borrow) {
+  const uint64_t s = b + *borrow;
+  *borrow = a < s;
+  return a - s + (*borrow ? kLimbBase : 0);
+}
+
+/**
+ * \brief r = a + b
+ * \return Carry out (0 or 1)
+ */
+inline uint64_t LimbsAddScalar(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                         size_t n) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    r[i] = LimbAdd(a[i], b[i], &carry);
+    r[i + 1] = LimbAdd(a[i + 1], b[i + 1], &carry);
+    r[i + 2] = LimbAdd(a[i + 2], b[i + 2], &carry);
+    r[i + 3] = LimbAdd(a[i + 3], b[i + 3], &carry);
+  }
+  for (; i < n; ++i) {
+    r[i] = LimbAdd(a[i], b[i], &carry);
+  }
+
+  return carry;
+}
+
+/**
+ * \brief r = a + carry
+ * \return Carry out (0 or 1)
+ */
+inline uint64_t LimbsAddCarry(uint64_t *r, const uint64_t *a, size_t n,
+                              uint64_t carry) {
+  size_t i = 0;
+  for (; carry && i < n; ++i) {
+    r[i] = LimbAdd(a[i], 0, &carry);
+  }
+  if (r != a) {
+    std::copy(a + i, a + n, r + i);
+  }
+
+  return carry;
+}
+
+/**
+ * \brief r = a - b
+ * \return Borrow out (0 or 1)
+ */
+inline uint64_t LimbsSubScalar(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                         size_t n) {
+  uint64_t borrow = 0;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    r[i] = LimbSub(a[i], b[i], &borrow);
+    r[i + 1] = LimbSub(a[i + 1], b[i + 1], &borrow);
+    r[i + 2] = LimbSub(a[i + 2], b[i + 2], &borrow);
+    r[i + 3] = LimbSub(a[i + 3], b[i + 3], &borrow);
+  }
+  for (; i < n; ++i) {
+    r[i] = LimbSub(a[i], b[i], &borrow);
+  }
+
+  return borrow;
+}
+
+/**
+ * \brief r = a - borrow
+ * \return Borrow out (0 or 1)
+ */
+inline uint64_t LimbsSubBorrow(uint64_t *r, const uint64_t *a, size_t n,
+                               uint64_t borrow) {
+  size_t i = 0;
+  for (; borrow && i < n; ++i) {
+    r[i] = LimbSub(a[i], 0, &borrow);
+  }
+  if (r != a) {
+    std::copy(a + i, a + n, r + i);
+  }
+
+  return borrow;
+}
+
+//! limb * m + carry < base * m, so a 64 bit product is enough up to this m
+constexpr uint64_t kLimbMulSmallMax = UINT64_MAX / kLimbBase;
+
+/**
+ * \brief r = a * m
+ * \return Carry out limb (may be >= base when m >= base)
+ */
+inline uint64_t LimbsMulSmallScalar(uint64_t *r, const uint64_t *a, size_t n,
+                                    uint64_t m) {
+  uint64_t carry = 0;
+  size_t i = 0;
+  if (m <= kLimbMulSmallMax) {
+    for (; i + 4 <= n; i += 4) {
+      for (size_t j = 0; j < 4; ++j) {
+        const uint64_t prod = a[i + j] * m + carry;
+        r[i + j] = prod % kLimbBase;
+        carry = prod / kLimbBase;
+      }
+    }
+    for (; i < n; ++i) {
+      const uint64_t prod = a[i] * m + carry;
+      r[i] = prod % kLimbBase;
+      carry = prod / kLimbBase;
+    }
+
+    return carry;
+  }
+
+  for (; i < n; ++i) {
+    const unsigned __int128 prod =
+        static_cast<unsigned __int128>(a[i]) * m + carry;
+    uint64_t rem = 0;
+    carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(prod >> 64),
+                                     static_cast<uint64_t>(prod), &rem);
+    r[i] = rem;
+  }
+
+  return carry;
+}
+
+//! Most words LimbsMulWords() applies in one pass over the limbs (the pass is
+//! bound by the 128 bit splits, not by memory: more words do not pay)
+constexpr size_t kMulWordsMax = 2;
+
+/**
+ * \brief r = a * m[0] * ... * m[K - 1], one pass over a
+ *
+ * Each limb is loaded once and goes through the K products in registers;
+ * every word keeps its own carry (carry < word, so any 64 bit word is fine).
+ *
+ * \param r Output of n + 2 * K limbs (may be a; top limbs may be zero)
+ */
+template <size_t K>
+inline void LimbsMulWordsK(uint64_t *r, const uint64_t *a, size_t n,
+                           const uint64_t *m) {
+  uint64_t carry[K] = {};
+  auto step = [&](uint64_t v) {
+    for (size_t k = 0; k < K; ++k) {
+      const unsigned __int128 prod =
+          static_cast<unsigned __int128>(v) * m[k] + carry[k];
+      carry[k] = Div128ByConst<kLimbBase>(static_cast<uint64_t>(prod >> 64),
+                                          static_cast<uint64_t>(prod), &v);
+    }
+    return v;
+  };
+
+  for (size_t i = 0; i < n; ++i) {
+    r[i] = step(a[i]);
+  }
+  // flush carries: words are below base^2, so 2 limbs each
+  for (size_t i = n; i < n + 2 * K; ++i) {
+    r[i] = step(0);
+  }
+}
+
+/**
+ * \brief r = a * m[0] * ... * m[k - 1] (k <= kMulWordsMax)
+ * \param r Output of n + 2 * k limbs (may be a; top limbs may be zero)
+ */
+inline void LimbsMulWords(uint64_t *r, const uint64_t *a, size_t n,
+                          const uint64_t *m, size_t k) {
+  assert(k >= 1 && k <= kMulWordsMax);
+  if (k == 2) {
+    LimbsMulWordsK<2>(r, a, n, m);
+  } else {
+    LimbsMulWordsK<1>(r, a, n, m);
+  }
+}
+
+/**
+ * \brief q = a / d
+ * \return Remainder
+ */
+inline uint64_t LimbsDivSmall(uint64_t *q, const uint64_t *a, size_t n,
+                              uint64_t d) {
+  uint64_t rem = 0;
+  for (size_t i = n; i-- > 0;) {
+    // rem < d, so rem * base + limb < d * base and quotient fits a limb
+    const unsigned __int128 cur =
+        static_cast<unsigned __int128>(rem) * kLimbBase + a[i];
+    q[i] = Div128By64(static_cast<uint64_t>(cur >> 64),
+                      static_cast<uint64_t>(cur), d, &rem);
+  }
+
+  return rem;
+}
+
+/**
+ * \brief Compare a and b of same size
+ * \return -1 if a < b; 0 if a == b; 1 if a > b
+ */
+inline int32_t LimbsCmp(const uint64_t *a, const uint64_t *b, size_t n) {
+  for (size_t i = n; i-- > 0;) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * \brief r = r + a * m
+ * \return Carry out limb
+ */
+inline uint64_t LimbsAddMul(uint64_t *r, const uint64_t *a, size_t n,
+                            uint64_t m) {
+  uint64_t carry = 0;
+  for (size_t i = 0; i < n; ++i) {
+    // < base^2, so quotient by base fits a limb
+    const unsigned __int128 prod =
+        static_cast<unsigned __int128>(a[i]) * m + r[i] + carry;
+    carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(prod >> 64),
+                                     static_cast<uint64_t>(prod), &r[i]);
+  }
+
+  return carry;
+}
+
+/**
+ * \brief r = a * b (schoolbook)
+ * \param r Output of n + m limbs (must not overlap a or b)
+ */
+inline void LimbsMul(uint64_t *r, const uint64_t *a, size_t n,
+                     const uint64_t *b, size_t m) {
+  std::fill(r, r + n + m, 0);
+  for (size_t j = 0; j < m; ++j) {
+    r[j + n] = LimbsAddMul(r + j, a, n, b[j]);
+  }
+}
+
+//! Largest column Comba can sum in 128 bits (column sum < base * 2^64)
+constexpr size_t kCombaMaxColumn = 18000;
+
+/**
+ * \brief r = a * b, column by column (Comba)
+ * \param r Output of n + m limbs (must not overlap a or b)
+ */
+inline void LimbsMulCombaScalar(uint64_t *r, const uint64_t *a, size_t n,
+                                const uint64_t *b, size_t m) {
+  assert(std::min(n, m) <= kCombaMaxColumn);
+  uint64_t carry = 0;
+  for (size_t c = 0; c + 1 < n + m; ++c) {
+    const size_t lo = c < m ? 0 : c - m + 1;
+    const size_t hi = std::min(c, n - 1);
+
+    unsigned __int128 acc = carry;
+    for (size_t i = lo; i <= hi; ++i) {
+      acc += static_cast<unsigned __int128>(a[i]) * b[c - i];
+    }
+    carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(acc >> 64),
+                                     static_cast<uint64_t>(acc), &r[c]);
+  }
+  r[n + m - 1] = carry;
+}
+
+/**
+ * \brief Build table with sum of digits of every number below 10^4
+ * \return Table
+ */
+constexpr std::array<uint8_t, 10000> MakeDigitSum4Table() {
+  std::array<uint8_t, 10000> table{};
+  for (uint32_t i = 0; i < table.size(); ++i) {
+    table[i] = static_cast<uint8_t>(i % 10 + i / 10 % 10 + i / 100 % 10 +
+                                    i / 1000);
+  }
+
+  return table;
+}
+
+inline constexpr std::array<uint8_t, 10000> kDigitSum4 =
+    MakeDigitSum4Table();  //!< Sum of digits of numbers below 10^4
+
+//! Two char decimal representation of numbers below 100 ("00" to "99")
+inline constexpr char kDigitPairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536"
+    "37383940414243444546474849505152535455565758596061626364656667686970717273"
+    "7475767778798081828384858687888990919293949596979899";
+
+/**
+ * \brief Sum decimal digits of all limbs
+ * \return Sum of digits
+ */
+inline uint64_t LimbsDigitSumScalar(const uint64_t *a, size_t n) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const uint64_t hi = a[i] / 100000000;  // 7 digits
+    const uint64_t lo = a[i] % 100000000;  // 8 digits
+    sum += kDigitSum4[hi / 10000] + kDigitSum4[hi % 10000] +
+           kDigitSum4[lo / 10000] + kDigitSum4[lo % 10000];
+  }
+
+  return sum;
+}
+
+/**
+ * \brief Write 4 decimal digits (zero padded)
+ * \param out Output (4 chars)
+ * \param chunk Number below 10^4
+ */
+inline void FormatChunk4(char *out, uint32_t chunk) {
+  const char *hi = kDigitPairs + 2 * (chunk / 100);
+  const char *lo = kDigitPairs + 2 * (chunk % 100);
+  out[0] = hi[0];
+  out[1] = hi[1];
+  out[2] = lo[0];
+  out[3] = lo[1];
+}
+
+/**
+ * \brief Write one limb from its 4 digit chunks (15 chars, zero padded)
+ * \param out Output (15 chars)
+ * \param c3 Top chunk (3 digits)
+ * \param c2 Chunk (4 digits)
+ * \param c1 Chunk (4 digits)
+ * \param c0 Bottom chunk (4 digits)
+ */
+inline void FormatLimbChunks(char *out, uint32_t c3, uint32_t c2, uint32_t c1,
+                             uint32_t c0) {
+  out[0] = static_cast<char>('0' + c3 / 100);
+  out[1] = kDigitPairs[2 * (c3 % 100)];
+  out[2] = kDigitPairs[2 * (c3 % 100) + 1];
+  FormatChunk4(out + 3, c2);
+  FormatChunk4(out + 7, c1);
+  FormatChunk4(out + 11, c0);
+}
+
+/**
+ * \brief Write limbs as decimal, most significant first, 15 chars per limb
+ * \param out Output (15 * n chars)
+ */
+inline void LimbsFormatScalar(char *out, const uint64_t *a, size_t n) {
+  for (size_t i = n; i-- > 0; out += 15) {
+    const uint64_t hi = a[i] / 100000000;
+    const uint64_t lo = a[i] % 100000000;
+    FormatLimbChunks(out, static_cast<uint32_t>(hi / 10000),
+                     static_cast<uint32_t>(hi % 10000),
+                     static_cast<uint32_t>(lo / 10000),
+                     static_cast<uint32_t>(lo % 10000));
+  }
+}
+
+#if defined(__x86_64__)
+
+/**
+ * SIMD limb kernels
+ *
+ * Carry chains do not vectorize, so multiply computes every limb product and
+ * its quotient by base independently (quotient from a double estimate, fixed
+ * by one exact step), adds quotients one limb up, and only walks a carry
+ * chain in the rare block where a sum reaches base.
+ *
+ * Divisions by powers of 10 use doubles (limbs are below 2^50, exact in a
+ * double) or 32 bit multiply by reciprocal.
+ *
+ * Formatting has no SIMD version: splitting limbs in SIMD and writing chars
+ * from the pair table was slower than LimbsFormatScalar.
+ */
+
+/**
+ * \brief Fix limbs of a block that reached base after adding quotients
+ * \param r Block of limbs
+ * \param n Limbs in block
+ * \return Carry into next block (0 or 1)
+ */
+inline uint64_t LimbsFixBlock(uint64_t *r, size_t n) {
+  uint64_t carry = 0;
+  for (size_t j = 0; j < n; ++j) {
+    r[j] += carry;
+    carry = r[j] >= kLimbBase;
+    r[j] -= carry ? kLimbBase : 0;
+  }
+
+  return carry;
+}
+
+/**
+ * \brief r = a * m + carry for limbs left after the last block
+ * \return Carry out limb
+ */
+inline uint64_t LimbsMulSmallTail(uint64_t *r, const uint64_t *a, size_t n,
+                                  uint64_t m, uint64_t carry) {
+  for (size_t i = 0; i < n; ++i) {
+    const uint64_t prod = a[i] * m + carry;
+    r[i] = prod % kLimbBase;
+    carry = prod / kLimbBase;
+  }
+
+  return carry;
+}
+
+/**
+ * \brief Convert 64 bit lanes below 2^52 to double (exact)
+ */
+__attribute__((target("avx2"))) inline __m256d U52ToDoubleAvx2(__m256i v) {
+  const __m256d magic = _mm256_set1_pd(4503599627370496.0);  // 2^52
+  return _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(v, _mm256_castpd_si256(magic))),
+      magic);
+}
+
+/**
+ * \brief Convert integral doubles below 2^52 to 64 bit lanes (exact)
+ */
+__attribute__((target("avx2"))) inline __m256i DoubleToU52Avx2(__m256d d) {
+  const __m256d magic = _mm256_set1_pd(4503599627370496.0);  // 2^52
+  return _mm256_xor_si256(_mm256_castpd_si256(_mm256_add_pd(d, magic)),
+                          _mm256_castpd_si256(magic));
+}
+
+/**
+ * \brief 64 bit lanes times 32 bit number (low 64 bits of product)
+ * \param a Lanes
+ * \param m Multiplier in low 32 bits of each lane
+ */
+__attribute__((target("avx2"))) inline __m256i MulLo64x32Avx2(__m256i a,
+                                                                __m256i m) {
+  const __m256i lo = _mm256_mul_epu32(a, m);
+  const __m256i hi = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+}
+
+/**
+ * \brief r = a * m (AVX2, 4 limbs per step)
+ * \return Carry out limb
+ */
+__attribute__((target("avx2"))) inline uint64_t LimbsMulSmallAvx2(
+    uint64_t *r, const uint64_t *a, size_t n, uint64_t m) {
+  if (m > kLimbMulSmallMax) {
+    return LimbsMulSmallScalar(r, a, n, m);
+  }
+
+  const __m256i vm = _mm256_set1_epi64x(static_cast<int64_t>(m));
+  const __m256i base = _mm256_set1_epi64x(kLimbBase);
+  const __m256i base_lo = _mm256_set1_epi64x(kLimbBase & 0xffffffff);
+  const __m256i base_hi = _mm256_set1_epi64x(kLimbBase >> 32);
+  const __m256i base_m1 = _mm256_set1_epi64x(kLimbBase - 1);
+  const __m256i one = _mm256_set1_epi64x(1);
+  const __m256i low32 = _mm256_set1_epi64x(0xffffffff);
+  const __m256d two32 = _mm256_set1_pd(4294967296.0);
+  const __m256d inv_base = _mm256_set1_pd(1e-15);
+
+  // quotient of the limb below the block, in every lane
+  __m256i carry = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i p = MulLo64x32Avx2(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)), vm);
+
+    // q = p / base estimated with doubles (p may exceed 2^53: split halves)
+    const __m256d pd = _mm256_add_pd(
+        _mm256_mul_pd(U52ToDoubleAvx2(_mm256_srli_epi64(p, 32)), two32),
+        U52ToDoubleAvx2(_mm256_and_si256(p, low32)));
+    __m256i q = DoubleToU52Avx2(_mm256_floor_pd(_mm256_mul_pd(pd, inv_base)));
+
+    // exact remainder, then fix estimate by one either way
+    __m256i rem = _mm256_sub_epi64(
+        p, _mm256_add_epi64(
+               _mm256_mul_epu32(q, base_lo),
+               _mm256_slli_epi64(_mm256_mul_epu32(q, base_hi), 32)));
+    const __m256i neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), rem);
+    rem = _mm256_add_epi64(rem, _mm256_and_si256(neg, base));
+    q = _mm256_add_epi64(q, neg);  // neg is -1
+    const __m256i big = _mm256_cmpgt_epi64(rem, base_m1);
+    rem = _mm256_sub_epi64(rem, _mm256_and_si256(big, base));
+    q = _mm256_add_epi64(q, _mm256_and_si256(big, one));
+
+    // add quotient of the limb below: [carry, q0, q1, q2]
+    const __m256i q_up =
+        _mm256_blend_epi32(_mm256_permute4x64_epi64(q, 0x90), carry, 0x03);
+    const __m256i sum = _mm256_add_epi64(rem, q_up);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(r + i), sum);
+
+    carry = _mm256_permute4x64_epi64(q, 0xff);
+    if (_mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpgt_epi64(sum, base_m1)))) {
+      carry = _mm256_add_epi64(
+          carry, _mm256_set1_epi64x(
+                     static_cast<int64_t>(LimbsFixBlock(r + i, 4))));
+    }
+  }
+
+  return LimbsMulSmallTail(
+      r + i, a + i, n - i, m,
+      static_cast<uint64_t>(_mm_cvtsi128_si64(_mm256_castsi256_si128(carry))));
+}
+
+/**
+ * \brief r = a * m (AVX-512, 8 limbs per step)
+ * \return Carry out limb
+ */
+__attribute__((target("avx512f,avx512dq"))) inline uint64_t
+LimbsMulSmallAvx512(uint64_t *r, const uint64_t *a, size_t n, uint64_t m) {
+  if (m > kLimbMulSmallMax) {
+    return LimbsMulSmallScalar(r, a, n, m);
+  }
+
+  const __m512i vm = _mm512_set1_epi64(static_cast<int64_t>(m));
+  const __m512i base = _mm512_set1_epi64(kLimbBase);
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512d inv_base = _mm512_set1_pd(1e-15);
+  const __m512i shift_up = _mm512_set_epi64(6, 5, 4, 3, 2, 1, 0, 0);
+  const __m512i top = _mm512_set1_epi64(7);
+
+  // quotient of the limb below the block, in every lane
+  __m512i carry = _mm512_setzero_si512();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m512i p = _mm512_mullo_epi64(_mm512_loadu_si512(a + i), vm);
+
+    __m512i q = _mm512_cvttpd_epu64(
+        _mm512_mul_pd(_mm512_cvtepu64_pd(p), inv_base));
+    __m512i rem = _mm512_sub_epi64(p, _mm512_mullo_epi64(q, base));
+    const __mmask8 neg = _mm512_cmplt_epi64_mask(rem, _mm512_setzero_si512());
+    rem = _mm512_mask_add_epi64(rem, neg, rem, base);
+    q = _mm512_mask_sub_epi64(q, neg, q, one);
+    const __mmask8 big = _mm512_cmpge_epi64_mask(rem, base);
+    rem = _mm512_mask_sub_epi64(rem, big, rem, base);
+    q = _mm512_mask_add_epi64(q, big, q, one);
+
+    // add quotient of the limb below: [carry, q0, ..., q6]
+    const __m512i q_up =
+        _mm512_mask_permutexvar_epi64(carry, 0xfe, shift_up, q);
+    const __m512i sum = _mm512_add_epi64(rem, q_up);
+    _mm512_storeu_si512(r + i, sum);
+
+    carry = _mm512_maskz_permutexvar_epi64(0xff, top, q);
+    if (_mm512_cmpge_epi64_mask(sum, base)) {
+      carry = _mm512_add_epi64(
+          carry,
+          _mm512_set1_epi64(static_cast<int64_t>(LimbsFixBlock(r + i, 8))));
+    }
+  }
+
+  alignas(64) uint64_t lanes[8];
+  _mm512_store_si512(lanes, carry);
+
+  return LimbsMulSmallTail(r + i, a + i, n - i, m, lanes[0]);
+}
+
+/**
+ * \brief Split 4 limbs into 4 digit chunks
+ * \param a 4 limbs
+ * \param c Chunks, c[3] top (3 digits) to c[0] bottom
+ */
+__attribute__((target("avx2"))) inline void SplitLimbsAvx2(const uint64_t *a,
+                                                           __m256i c[4]) {
+  const __m256d e8 = _mm256_set1_pd(1e8);
+  const __m256d inv_e8 = _mm256_set1_pd(1e-8);
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d zero = _mm256_setzero_pd();
+  // floor(v / 10^4) = (v * kMul) >> 40 for v < 4.9 * 10^8
+  const __m256i mul = _mm256_set1_epi64x(109951163);
+  const __m256i e4 = _mm256_set1_epi64x(10000);
+
+  // 15 digits -> 7 + 8 digits with doubles (exact below 2^53)
+  const __m256d v = U52ToDoubleAvx2(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a)));
+  __m256d hi = _mm256_floor_pd(_mm256_mul_pd(v, inv_e8));
+  __m256d lo = _mm256_sub_pd(v, _mm256_mul_pd(hi, e8));
+  const __m256d neg = _mm256_cmp_pd(lo, zero, _CMP_LT_OQ);
+  hi = _mm256_sub_pd(hi, _mm256_and_pd(neg, one));
+  lo = _mm256_add_pd(lo, _mm256_and_pd(neg, e8));
+  const __m256d big = _mm256_cmp_pd(lo, e8, _CMP_GE_OQ);
+  hi = _mm256_add_pd(hi, _mm256_and_pd(big, one));
+  lo = _mm256_sub_pd(lo, _mm256_and_pd(big, e8));
+
+  const __m256i hi_i = DoubleToU52Avx2(hi);
+  const __m256i lo_i = DoubleToU52Avx2(lo);
+  c[3] = _mm256_srli_epi64(_mm256_mul_epu32(hi_i, mul), 40);
+  c[2] = _mm256_sub_epi64(hi_i, _mm256_mul_epu32(c[3], e4));
+  c[1] = _mm256_srli_epi64(_mm256_mul_epu32(lo_i, mul), 40);
+  c[0] = _mm256_sub_epi64(lo_i, _mm256_mul_epu32(c[1], e4));
+}
+
+/**
+ * \brief Sum decimal digits of all limbs (AVX2, 4 limbs per step)
+ * \return Sum of digits
+ */
+__attribute__((target("avx2"))) inline uint64_t LimbsDigitSumAvx2(
+    const uint64_t *a, size_t n) {
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i nine = _mm256_set1_epi16(9);
+
+  __m256i acc = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    // 16 chunks below 10^4 in 16 bit lanes (order does not matter for a sum)
+    __m256i c[4];
+    SplitLimbsAvx2(a + i, c);
+    const __m256i x = _mm256_packus_epi32(_mm256_packus_epi32(c[0], c[1]),
+                                          _mm256_packus_epi32(c[2], c[3]));
+
+    // sum of digits of x = x - 9 * (x / 10 + x / 100 + x / 1000)
+    const __m256i q1 =
+        _mm256_srli_epi16(_mm256_mulhi_epu16(x, _mm256_set1_epi16(-13107)), 3);
+    const __m256i q2 = _mm256_srli_epi16(
+        _mm256_mulhi_epu16(_mm256_srli_epi16(x, 2), _mm256_set1_epi16(5243)),
+        1);
+    const __m256i q3 = _mm256_srli_epi16(
+        _mm256_mulhi_epu16(_mm256_srli_epi16(x, 3), _mm256_set1_epi16(8389)),
+        4);
+    const __m256i sum = _mm256_sub_epi16(
+        x, _mm256_mullo_epi16(
+               nine, _mm256_add_epi16(q1, _mm256_add_epi16(q2, q3))));
+    acc = _mm256_add_epi32(acc, _mm256_madd_epi16(sum, ones));
+  }
+
+  alignas(32) uint32_t lanes[8];
+  _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), acc);
+  uint64_t total = 0;
+  for (const uint32_t lane : lanes) {
+    total += lane;
+  }
+
+  return total + LimbsDigitSumScalar(a + i, n - i);
+}
+
+/**
+ * Carry flag kernels (BMI2, ADX)
+ *
+ * A decimal carry is a compare, not a carry flag: a + b + carry >= base. With
+ * a biased by 2^64 - base, though, the sum overflows 64 bits exactly when it
+ * reaches base, so add runs on the CPU carry chain (adcx) and only fixes each
+ * limb with a flag free lea / cmov; subtract does the same with sbb (there is
+ * no sbb of ADX, and none is needed: a binary borrow is the decimal one).
+ *
+ * Comba sums a column with mulx (which leaves flags alone) into two 128 bit
+ * accumulators, one on the carry flag (adcx) and one on the overflow flag
+ * (adox), so two chains of products overlap. A column is below 2^128 (see
+ * kCombaMaxColumn), so the high word of an accumulator never carries out.
+ */
+
+/**
+ * \brief r = a + b (carry flag chain, 4 limbs per step)
+ * \return Carry out (0 or 1)
+ */
+__attribute__((target("adx"))) inline uint64_t LimbsAddAdx(uint64_t *r,
+                                                           const uint64_t *a,
+                                                           const uint64_t *b,
+                                                           size_t n) {
+  uint64_t carry = 0;
+  size_t steps = n / 4;
+  if (steps > 0) {
+    const uint64_t bias = 0 - kLimbBase;
+    uint64_t s = 0;
+    uint64_t t = 0;
+    const uint64_t *pa = a;
+    const uint64_t *pb = b;
+    uint64_t *pr = r;
+    // dec leaves the carry flag alone, so it closes the loop
+    __asm__(
+        "xor %k[s], %k[s]\n\t"
+        "1:\n\t"
+        ".irp k, 0, 8, 16, 24\n\t"
+        "movq \\k(%[a]), %[s]\n\t"
+        "leaq (%[s], %[bias]), %[s]\n\t"
+        "adcxq \\k(%[b]), %[s]\n\t"
+        "leaq (%[s], %[base]), %[t]\n\t"
+        "cmovncq %[t], %[s]\n\t"
+        "movq %[s], \\k(%[r])\n\t"
+        ".endr\n\t"
+        "leaq 32(%[a]), %[a]\n\t"
+        "leaq 32(%[b]), %[b]\n\t"
+        "leaq 32(%[r]), %[r]\n\t"
+        "decq %[steps]\n\t"
+        "jnz 1b\n\t"
+        "setc %b[t]\n\t"
+        "movzbl %b[t], %k[t]\n\t"
+        : [s] "=&r"(s), [t] "=&q"(t), [a] "+r"(pa), [b] "+r"(pb),
+          [r] "+r"(pr), [steps] "+r"(steps)
+        : [bias] "r"(bias), [base] "r"(kLimbBase)
+        : "cc", "memory");
+    carry = t;
+  }
+  for (size_t i = n / 4 * 4; i < n; ++i) {
+    r[i] = LimbAdd(a[i], b[i], &carry);
+  }
+
+  return carry;
+}
+
+/**
+ * \brief r = a - b (borrow flag chain, 4 limbs per step)
+ * \return Borrow out (0 or 1)
+ */
+inline uint64_t LimbsSubAdx(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                            size_t n) {
+  uint64_t borrow = 0;
+  size_t steps = n / 4;
+  if (steps > 0) {
+    uint64_t s = 0;
+    uint64_t t = 0;
+    const uint64_t *pa = a;
+    const uint64_t *pb = b;
+    uint64_t *pr = r;
+    __asm__(
+        "xor %k[s], %k[s]\n\t"
+        "1:\n\t"
+        ".irp k, 0, 8, 16, 24\n\t"
+        "movq \\k(%[a]), %[s]\n\t"
+        "sbbq \\k(%[b]), %[s]\n\t"
+        "leaq (%[s], %[base]), %[t]\n\t"
+        "cmovcq %[t], %[s]\n\t"
+        "movq %[s], \\k(%[r])\n\t"
+        ".endr\n\t"
+        "leaq 32(%[a]), %[a]\n\t"
+        "leaq 32(%[b]), %[b]\n\t"
+        "leaq 32(%[r]), %[r]\n\t"
+        "decq %[steps]\n\t"
+        "jnz 1b\n\t"
+        "setc %b[t]\n\t"
+        "movzbl %b[t], %k[t]\n\t"
+        : [s] "=&r"(s), [t] "=&q"(t), [a] "+r"(pa), [b] "+r"(pb),
+          [r] "+r"(pr), [steps] "+r"(steps)
+        : [base] "r"(kLimbBase)
+        : "cc", "memory");
+    borrow = t;
+  }
+  for (size_t i = n / 4 * 4; i < n; ++i) {
+    r[i] = LimbSub(a[i], b[i], &borrow);
+  }
+
+  return borrow;
+}
+
+/**
+ * \brief Sum of a[i] * b[-i] for i < len, on two flag chains
+ * \param b Last limb of the column walk (read downwards)
+ */
+__attribute__((target("bmi2,adx"))) inline unsigned __int128 LimbsColumnAdx(
+    const uint64_t *a, const uint64_t *b, size_t len) {
+  uint64_t lo0 = 0;
+  uint64_t hi0 = 0;
+  uint64_t lo1 = 0;
+  uint64_t hi1 = 0;
+  size_t i = 0;
+  for (; i + 4 <= len; i += 4) {
+    uint64_t pl = 0;
+    uint64_t ph = 0;
+    __asm__(
+        "xor %k[pl], %k[pl]\n\t"
+        "movq (%[a]), %%rdx\n\t"
+        "mulxq (%[b]), %[pl], %[ph]\n\t"
+        "adcxq %[pl], %[lo0]\n\t"
+        "adcxq %[ph], %[hi0]\n\t"
+        "movq 8(%[a]), %%rdx\n\t"
+        "mulxq -8(%[b]), %[pl], %[ph]\n\t"
+        "adoxq %[pl], %[lo1]\n\t"
+        "adoxq %[ph], %[hi1]\n\t"
+        "movq 16(%[a]), %%rdx\n\t"
+        "mulxq -16(%[b]), %[pl], %[ph]\n\t"
+        "adcxq %[pl], %[lo0]\n\t"
+        "adcxq %[ph], %[hi0]\n\t"
+        "movq 24(%[a]), %%rdx\n\t"
+        "mulxq -24(%[b]), %[pl], %[ph]\n\t"
+        "adoxq %[pl], %[lo1]\n\t"
+        "adoxq %[ph], %[hi1]\n\t"
+        : [lo0] "+r"(lo0), [hi0] "+r"(hi0), [lo1] "+r"(lo1), [hi1] "+r"(hi1),
+          [pl] "=&r"(pl), [ph] "=&r"(ph)
+        : [a] "r"(a + i), [b] "r"(b - i)
+        : "cc", "rdx", "memory");
+  }
+
+  unsigned __int128 acc = ((static_cast<unsigned __int128>(hi0) << 64) | lo0) +
+                          ((static_cast<unsigned __int128>(hi1) << 64) | lo1);
+  for (; i < len; ++i) {
+    acc += static_cast<unsigned __int128>(a[i]) * *(b - i);
+  }
+
+  return acc;
+}
+
+//! n + m below which columns are too short for two chains (scalar is faster)
+constexpr size_t kCombaAdxMinLimbs = 48;
+
+/**
+ * \brief r = a * b, column by column (Comba on mulx / adcx / adox)
+ * \param r Output of n + m limbs (must not overlap a or b)
+ */
+__attribute__((target("bmi2,adx"))) inline void LimbsMulCombaAdx(
+    uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b, size_t m) {
+  if (n + m < kCombaAdxMinLimbs) {
+    LimbsMulCombaScalar(r, a, n, b, m);
+    return;
+  }
+
+  assert(std::min(n, m) <= kCombaMaxColumn);
+  uint64_t carry = 0;
+  for (size_t c = 0; c + 1 < n + m; ++c) {
+    const size_t lo = c < m ? 0 : c - m + 1;
+    const size_t hi = std::min(c, n - 1);
+
+    const unsigned __int128 acc =
+        LimbsColumnAdx(a + lo, b + (c - lo), hi - lo + 1) + carry;
+    carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(acc >> 64),
+                                     static_cast<uint64_t>(acc), &r[c]);
+  }
+  r[n + m - 1] = carry;
+}
+
+#endif  // defined(__x86_64__)
+
+#endif  // LIMB_KERNELS_H_
@@ -0,0 +1,244 @@
+/**
+ * \brief Cellcrypt big number multiplication kernels
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * BigNum by BigNum multiplication on base 10^15 limbs.
+ *
+ * - Comba: output is built column by column, every column summed in a 128 bit
+ *   accumulator (products are below 10^30 < 2^100, so a column can take 18000
+ *   of them) and split once; partial rows are never stored and reloaded.
+ *   Small square sizes have fully unrolled versions built by templates;
+ * - Karatsuba: three half size products instead of four, down to Comba below
+ *   kKaratsubaThreshold limbs.
+ *
+ * Comba columns and the adds and subtracts of Karatsuba go through the CPU
+ * dispatch table (cpu_dispatch.h): on a CPU with BMI2 and ADX they run on
+ * mulx / adcx / adox carry chains (LimbsMulCombaAdx(), LimbsAddAdx()).
+ */
+
+#ifndef LIMB_MUL_H_
+#define LIMB_MUL_H_
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "cpu_dispatch.h"
+#include "limb_kernels.h"
+
+//! Smaller operand limbs below which Karatsuba falls back to Comba
+constexpr size_t kKaratsubaThreshold = 48;
+
+//! Largest n with a fully unrolled n by n Comba
+constexpr size_t kCombaUnrollMax = 16;
+
+/**
+ * \brief Sum of column C of an N by N product, one product per index
+ */
+template <size_t N, size_t C, size_t... I>
+inline unsigned __int128 CombaColumnSum(const uint64_t *a, const uint64_t *b,
+                                        std::index_sequence<I...>) {
+  constexpr size_t kLo = C < N ? 0 : C - N + 1;
+  return (static_cast<unsigned __int128>(0) + ... +
+          (static_cast<unsigned __int128>(a[kLo + I]) * b[C - kLo - I]));
+}
+
+/**
+ * \brief Write limb C of an N by N product
+ * \return Carry into next column
+ */
+template <size_t N, size_t C>
+inline uint64_t CombaColumn(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                            uint64_t carry) {
+  constexpr size_t kLen = C < N ? C + 1 : 2 * N - 1 - C;
+  const unsigned __int128 acc =
+      CombaColumnSum<N, C>(a, b, std::make_index_sequence<kLen>()) + carry;
+
+  return Div128ByConst<kLimbBase>(static_cast<uint64_t>(acc >> 64),
+                                  static_cast<uint64_t>(acc), &r[C]);
+}
+
+template <size_t N, size_t... C>
+inline void CombaColumns(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                         std::index_sequence<C...>) {
+  uint64_t carry = 0;
+  ((carry = CombaColumn<N, C>(r, a, b, carry)), ...);
+  r[2 * N - 1] = carry;
+}
+
+/**
+ * \brief r = a * b for N limbs each, fully unrolled
+ * \param r Output of 2 * N limbs (must not overlap a or b)
+ */
+template <size_t N>
+inline void LimbsMulCombaFixed(uint64_t *r, const uint64_t *a,
+                               const uint64_t *b) {
+  CombaColumns<N>(r, a, b, std::make_index_sequence<2 * N - 1>());
+}
+
+using LimbsMulSquareFn = void (*)(uint64_t *, const uint64_t *,
+                                  const uint64_t *);
+
+template <size_t... N>
+constexpr std::array<LimbsMulSquareFn, sizeof...(N)> MakeCombaFixedTable(
+    std::index_sequence<N...>) {
+  return {&LimbsMulCombaFixed<N + 1>...};
+}
+
+//! Unrolled Comba by size; entry n - 1 multiplies n by n limbs
+inline constexpr std::array<LimbsMulSquareFn, kCombaUnrollMax> kCombaFixed =
+    MakeCombaFixedTable(std::make_index_sequence<kCombaUnrollMax>());
+
+/**
+ * \brief Comba, unrolled when both operands have the same small size
+ * \param r Output of n + m limbs (must not overlap a or b)
+ */
+inline void LimbsMulBase(uint64_t *r, const uint64_t *a, size_t n,
+                         const uint64_t *b, size_t m) {
+  if (n == m && n <= kCombaUnrollMax) {
+    kCombaFixed[n - 1](r, a, b);
+  } else {
+    LimbsMulComba(r, a, n, b, m);
+  }
+}
+
+/**
+ * \brief Scratch limbs LimbsMulKaratsuba() needs for operands of n limbs
+ *
+ * Each level takes 4 * (n / 2) + 12 limbs, so 4 * n plus 12 per level.
+ */
+constexpr size_t KaratsubaScratch(size_t n) { return 4 * n + 12 * 64; }
+
+/**
+ * \brief r = a * b (Karatsuba over Comba)
+ * \param r Output of n + m limbs (must not overlap a, b or scratch)
+ * \param a Operand of n limbs
+ * \param b Operand of m limbs (m <= n)
+ * \param scratch At least KaratsubaScratch(n) limbs
+ */
+inline void LimbsMulKaratsuba(uint64_t *r, const uint64_t *a, size_t n,
+                              const uint64_t *b, size_t m, uint64_t *scratch) {
+  assert(m <= n);
+  if (m == 0) {
+    std::fill(r, r + n, 0);
+    return;
+  }
+  if (m < kKaratsubaThreshold) {
+    LimbsMulBase(r, a, n, b, m);
+    return;
+  }
+
+  const size_t h = (n + 1) / 2;
+  if (m <= h) {
+    // unbalanced: a in chunks of m limbs, each a balanced product
+    uint64_t *t = scratch;
+    std::fill(r, r + n + m, 0);
+    for (size_t i = 0; i < n; i += m) {
+      const size_t k = std::min(m, n - i);
+      if (k >= m) {
+        LimbsMulKaratsuba(t, a + i, k, b, m, t + k + m);
+      } else {
+        LimbsMulKaratsuba(t, b, m, a + i, k, t + k + m);
+      }
+      const uint64_t carry = LimbsAdd(r + i, r + i, t, k + m);
+      LimbsAddCarry(r + i + k + m, r + i + k + m, n - i - k, carry);
+    }
+    return;
+  }
+
+  // a = a1 * B^h + a0, b = b1 * B^h + b0
+  const size_t na1 = n - h;
+  const size_t mb1 = m - h;
+  const size_t z2_len = na1 + mb1;
+
+  // z0 = a0 * b0 and z2 = a1 * b1 land on their own halves of r
+  LimbsMulKaratsuba(r, a, h, b, h, scratch);
+  LimbsMulKaratsuba(r + 2 * h, a + h, na1, b + h, mb1, scratch);
+
+  // z1 = (a0 + a1) * (b0 + b1) - z0 - z2
+  uint64_t *sa = scratch;
+  uint64_t *sb = sa + h + 1;
+  uint64_t *t = sb + h + 1;
+  uint64_t *rest = t + 2 * h + 2;
+  sa[h] = LimbsAddCarry(sa + na1, a + na1, h - na1,
+                        LimbsAdd(sa, a, a + h, na1));
+  sb[h] = LimbsAddCarry(sb + mb1, b + mb1, h - mb1,
+                        LimbsAdd(sb, b, b + h, mb1));
+  LimbsMulKaratsuba(t, sa, h + 1, sb, h + 1, rest);
+
+  LimbsSubBorrow(t + 2 * h, t + 2 * h, 2, LimbsSub(t, t, r, 2 * h));
+  LimbsSubBorrow(t + z2_len, t + z2_len, 2 * h + 2 - z2_len,
+                 LimbsSub(t, t, r + 2 * h, z2_len));
+
+  // r += z1 * B^h; limbs of z1 past the end of r are zero
+  const size_t t_len = std::min(2 * h + 2, n + m - h);
+  const uint64_t carry = LimbsAdd(r + h, r + h, t, t_len);
+  LimbsAddCarry(r + h + t_len, r + h + t_len, n + m - h - t_len, carry);
+}
+
+//! Limbs of each operand in a tile of LimbsMulColumns(): two tiles and their
+//! column sums (16 bytes each) stay in L1
+constexpr size_t kMulTileLimbs = 512;
+
+/**
+ * \brief Column sums of a * b for columns [c0, c1), tiled (no carries)
+ *
+ * Pieces of the product may be computed independently (e.g. by threads) and
+ * joined with LimbsColumnsToLimbs().
+ *
+ * \param acc Output of c1 - c0 column sums
+ */
+inline void LimbsMulColumns(unsigned __int128 *acc, const uint64_t *a,
+                            size_t n, const uint64_t *b, size_t m, size_t c0,
+                            size_t c1) {
+  std::fill(acc, acc + (c1 - c0), 0);
+  const size_t i_begin = c0 >= m ? c0 - m + 1 : 0;
+  const size_t i_end = std::min(n, c1);
+
+  for (size_t i0 = i_begin; i0 < i_end; i0 += kMulTileLimbs) {
+    const size_t i1 = std::min(i_end, i0 + kMulTileLimbs);
+    const size_t j_begin = c0 >= i1 ? c0 - i1 + 1 : 0;
+    const size_t j_end = std::min(m, c1 - i0);
+
+    for (size_t j0 = j_begin; j0 < j_end; j0 += kMulTileLimbs) {
+      const size_t j1 = std::min(j_end, j0 + kMulTileLimbs);
+      for (size_t i = i0; i < i1; ++i) {
+        const size_t j_lo = std::max(j0, c0 > i ? c0 - i : 0);
+        const size_t j_hi = std::min(j1, c1 - i);
+        if (j_lo >= j_hi) {
+          continue;
+        }
+        unsigned __int128 *dst = acc + (i + j_lo - c0);
+        for (size_t j = j_lo; j < j_hi; ++j) {
+          *dst++ += static_cast<unsigned __int128>(a[i]) * b[j];
+        }
+      }
+    }
+  }
+}
+
+/**
+ * \brief Turn column sums into limbs
+ * \param r Output of n limbs
+ * \param acc Column sums (each < 10^30 * kCombaMaxColumn)
+ * \return Carry out of the last column
+ */
+inline uint64_t LimbsColumnsToLimbs(uint64_t *r, const unsigned __int128 *acc,
+                                    size_t n) {
+  uint64_t carry = 0;
+  for (size_t c = 0; c < n; ++c) {
+    const unsigned __int128 v = acc[c] + carry;
+    carry = Div128ByConst<kLimbBase>(static_cast<uint64_t>(v >> 64),
+                                     static_cast<uint64_t>(v), &r[c]);
+  }
+
+  return carry;
+}
+
+#endif  // LIMB_MUL_H_
@@ -0,0 +1,440 @@
+/**
+ * \brief Cellcrypt big number limb radix
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Limb type and radix of BasicBigNum, picked at compile time:
+ *
+ * - Radix10e9: uint32_t limbs, 64 bit products;
+ * - Radix10e15: uint64_t limbs (BigNum); the only radix with SIMD kernels;
+ * - Radix10e18, Radix10e19: uint64_t limbs, 128 bit products;
+ * - Radix2e64: uint64_t limbs, binary; decimal output needs a base conversion.
+ *
+ * Splitting a product into limbs (division by the base) is a multiply by a
+ * compile-time reciprocal for every radix: the compiler does it for 64 bit
+ * products; Div128ByConst() does it for 128 bit ones.
+ */
+
+#ifndef LIMB_RADIX_H_
+#define LIMB_RADIX_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "cpu_dispatch.h"
+#include "limb_kernels.h"
+#include "limb_mul.h"
+
+/**
+ * \brief Base 10^9 on uint32_t limbs
+ */
+struct Radix10e9 {
+  using Limb = uint32_t;  //!< Limb type
+  using Wide = uint64_t;  //!< Type holding a limb product
+
+  static constexpr Wide kBase = 1000000000;       //!< Limb base
+  static constexpr uint32_t kDigitsPerLimb = 9;   //!< Decimal digits per limb
+  static constexpr bool kDecimal = true;          //!< Base is power of 10
+};
+
+/**
+ * \brief Base 10^15 on uint64_t limbs
+ */
+struct Radix10e15 {
+  using Limb = uint64_t;
+  using Wide = unsigned __int128;
+
+  static constexpr Wide kBase = kLimbBase;
+  static constexpr uint32_t kDigitsPerLimb = 15;
+  static constexpr bool kDecimal = true;
+};
+
+/**
+ * \brief Base 10^18 on uint64_t limbs
+ */
+struct Radix10e18 {
+  using Limb = uint64_t;
+  using Wide = unsigned __int128;
+
+  static constexpr Wide kBase = 1000000000000000000;
+  static constexpr uint32_t kDigitsPerLimb = 18;
+  static constexpr bool kDecimal = true;
+};
+
+/**
+ * \brief Base 10^19 on uint64_t limbs (largest power of 10 in a limb)
+ */
+struct Radix10e19 {
+  using Limb = uint64_t;
+  using Wide = unsigned __int128;
+
+  static constexpr Wide kBase = 10000000000000000000u;
+  static constexpr uint32_t kDigitsPerLimb = 19;
+  static constexpr bool kDecimal = true;
+};
+
+/**
+ * \brief Base 2^64 on uint64_t limbs
+ */
+struct Radix2e64 {
+  using Limb = uint64_t;
+  using Wide = unsigned __int128;
+
+  static constexpr Wide kBase = static_cast<Wide>(1) << 64;
+  static constexpr uint32_t kDigitsPerLimb = 19;  //!< Decimal digits a limb
+                                                  //!< always holds
+  static constexpr bool kDecimal = false;
+};
+
+/**
+ * \brief Split x into x / base and x % base
+ * \param x Number (must be < base * 2^bits of limb)
+ * \param lo x % base
+ * \return x / base
+ */
+template <typename Radix>
+inline typename Radix::Limb RadixSplit(typename Radix::Wide x,
+                                       typename Radix::Limb *lo) {
+  using Limb = typename Radix::Limb;
+
+  if constexpr (!Radix::kDecimal) {
+    *lo = static_cast<Limb>(x);
+    return static_cast<Limb>(x >> (8 * sizeof(Limb)));
+  } else if constexpr (sizeof(typename Radix::Wide) == sizeof(uint64_t)) {
+    const uint64_t hi = x / Radix::kBase;
+    *lo = static_cast<Limb>(x - hi * Radix::kBase);
+    return static_cast<Limb>(hi);
+  } else {
+    uint64_t rem = 0;
+    const uint64_t hi = Div128ByConst<static_cast<uint64_t>(Radix::kBase)>(
+        static_cast<uint64_t>(x >> 64), static_cast<uint64_t>(x), &rem);
+    *lo = rem;
+    return hi;
+  }
+}
+
+/**
+ * \brief Limb operations for any radix (plain loops)
+ *
+ * Same contracts as the kernels on limb_kernels.h.
+ */
+template <typename Radix>
+struct LimbOpsGeneric {
+  using Limb = typename Radix::Limb;
+  using Wide = typename Radix::Wide;
+
+  /**
+   * \brief Add one limb with carry (0 or 1)
+   */
+  static Limb AddLimb(Limb a, Limb b, Limb *carry) {
+    if constexpr (!Radix::kDecimal) {
+      Limb s = a + b;
+      const Limb c = s < a;
+      s += *carry;
+      *carry = c | (s < *carry);
+      return s;
+    } else {
+      // b + carry <= base fits; a + that may wrap when base > 2^(bits - 1)
+      const Limb s = a + static_cast<Limb>(b + *carry);
+      const bool over = s < a || s >= Radix::kBase;
+      *carry = over;
+      return over ? s - static_cast<Limb>(Radix::kBase) : s;
+    }
+  }
+
+  /**
+   * \brief Subtract one limb with borrow (0 or 1)
+   */
+  static Limb SubLimb(Limb a, Limb b, Limb *borrow) {
+    if constexpr (!Radix::kDecimal) {
+      const Limb d = a - b;
+      const Limb c = a < b;
+      const Limb r = d - *borrow;
+      *borrow = c | (d < *borrow);
+      return r;
+    } else {
+      const Limb s = b + *borrow;
+      *borrow = a < s;
+      return a - s + (*borrow ? static_cast<Limb>(Radix::kBase) : 0);
+    }
+  }
+
+  static Limb Add(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = AddLimb(a[i], b[i], &carry);
+    }
+
+    return carry;
+  }
+
+  static Limb AddCarry(Limb *r, const Limb *a, size_t n, Limb carry) {
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = AddLimb(a[i], 0, &carry);
+    }
+
+    return carry;
+  }
+
+  static Limb Sub(Limb *r, const Limb *a, const Limb *b, size_t n) {
+    Limb borrow = 0;
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = SubLimb(a[i], b[i], &borrow);
+    }
+
+    return borrow;
+  }
+
+  static void SubBorrow(Limb *r, const Limb *a, size_t n, Limb borrow) {
+    for (size_t i = 0; i < n; ++i) {
+      r[i] = SubLimb(a[i], 0, &borrow);
+    }
+  }
+
+  static int32_t Cmp(const Limb *a, const Limb *b, size_t n) {
+    for (size_t i = n; i-- > 0;) {
+      if (a[i] != b[i]) {
+        return a[i] < b[i] ? -1 : 1;
+      }
+    }
+
+    return 0;
+  }
+
+  /**
+   * \brief r = a * m
+   * \return Carry out limb (may be >= base when m >= base)
+   */
+  static Limb MulSmall(Limb *r, const Limb *a, size_t n, Limb m) {
+    if (!Radix::kDecimal || m >= Radix::kBase) {
+      Limb carry = 0;
+      for (size_t i = 0; i < n; ++i) {
+        carry = RadixSplit<Radix>(static_cast<Wide>(a[i]) * m + carry, &r[i]);
+      }
+
+      return carry;
+    }
+
+    // products are split independently; only the add of the previous high
+    // part is a carry chain, so the splits overlap (hi < m < base)
+    Limb hi_prev = 0;
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+      Limb lo = 0;
+      const Limb hi = RadixSplit<Radix>(static_cast<Wide>(a[i]) * m, &lo);
+      r[i] = AddLimb(lo, hi_prev, &carry);
+      hi_prev = hi;
+    }
+
+    return hi_prev + carry;
+  }
+
+  //! Words up to this go through MulWords() as fast as any smaller word
+  static constexpr uint64_t kMulWordMax = static_cast<Limb>(~Limb(0));
+
+  //! Largest word with the fastest multiply (packing stops here below it)
+  static constexpr uint64_t kMulWordFastMax = kMulWordMax;
+
+  /**
+   * \brief r = a * m[0] * ... * m[k - 1] (k <= kMulWordsMax, m <= kMulWordMax)
+   * \param r Output of n + 2 * k limbs (may be a; top limbs may be zero)
+   */
+  static void MulWords(Limb *r, const Limb *a, size_t n, const uint64_t *m,
+                       size_t k) {
+    for (size_t j = 0; j < k; ++j, n += 2) {
+      const Limb carry = MulSmall(r, j == 0 ? a : r, n, static_cast<Limb>(m[j]));
+      r[n + 1] = RadixSplit<Radix>(carry, &r[n]);
+    }
+  }
+
+  /**
+   * \brief r = r + a * m
+   * \return Carry out limb
+   */
+  static Limb AddMul(Limb *r, const Limb *a, size_t n, Limb m) {
+    Limb carry = 0;
+    for (size_t i = 0; i < n; ++i) {
+      // < base^2, so quotient by base fits a limb
+      carry = RadixSplit<Radix>(static_cast<Wide>(a[i]) * m + r[i] + carry,
+                                &r[i]);
+    }
+
+    return carry;
+  }
+
+  /**
+   * \brief r = a * b (schoolbook)
+   * \param r Output of n + m limbs (must not overlap a or b)
+   */
+  static void Mul(Limb *r, const Limb *a, size_t n, const Limb *b, size_t m) {
+    std::fill(r, r + n + m, 0);
+    for (size_t j = 0; j < m; ++j) {
+      r[j + n] = AddMul(r + j, a, n, b[j]);
+    }
+  }
+
+  /**
+   * \brief q = a / d
+   * \return Remainder
+   */
+  static uint64_t DivSmall(Limb *q, const Limb *a, size_t n, uint64_t d) {
+    uint64_t rem = 0;
+    for (size_t i = n; i-- > 0;) {
+      // rem < d, so rem * base + limb < d * base and quotient fits a limb
+      const unsigned __int128 cur =
+          static_cast<unsigned __int128>(rem) * Radix::kBase + a[i];
+      q[i] = static_cast<Limb>(Div128By64(static_cast<uint64_t>(cur >> 64),
+                                          static_cast<uint64_t>(cur), d, &rem));
+    }
+
+    return rem;
+  }
+
+  /**
+   * \brief Remainder of a / d
+   */
+  static uint64_t ModSmall(const Limb *a, size_t n, uint64_t d) {
+    uint64_t rem = 0;
+    for (size_t i = n; i-- > 0;) {
+      const unsigned __int128 cur =
+          static_cast<unsigned __int128>(rem) * Radix::kBase + a[i];
+      Div128By64(static_cast<uint64_t>(cur >> 64), static_cast<uint64_t>(cur),
+                 d, &rem);
+    }
+
+    return rem;
+  }
+
+  /**
+   * \brief Sum of decimal digits of limbs (decimal radix only)
+   */
+  static uint64_t DigitSum(const Limb *a, size_t n) {
+    static_assert(Radix::kDecimal, "digits need a decimal radix");
+    uint64_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      for (Limb x = a[i]; x > 0; x /= 10000) {
+        sum += kDigitSum4[x % 10000];
+      }
+    }
+
+    return sum;
+  }
+
+  /**
+   * \brief Limbs to decimal, most significant first, kDigitsPerLimb chars each
+   *        (decimal radix only)
+   */
+  static void Format(char *out, const Limb *a, size_t n) {
+    static_assert(Radix::kDecimal, "digits need a decimal radix");
+    constexpr uint32_t kDigits = Radix::kDigitsPerLimb;
+    for (size_t i = n; i-- > 0; out += kDigits) {
+      Limb x = a[i];
+      uint32_t k = kDigits;
+      for (; k >= 2; k -= 2, x /= 100) {
+        const char *pair = kDigitPairs + 2 * (x % 100);
+        out[k - 2] = pair[0];
+        out[k - 1] = pair[1];
+      }
+      if (k == 1) {
+        out[0] = static_cast<char>('0' + x);
+      }
+    }
+  }
+};
+
+/**
+ * \brief Limb operations for a radix
+ */
+template <typename Radix>
+struct LimbOps : LimbOpsGeneric<Radix> {};
+
+/**
+ * \brief Limb operations for base 10^15: unrolled and dispatched kernels
+ */
+template <>
+struct LimbOps<Radix10e15> : LimbOpsGeneric<Radix10e15> {
+  static uint64_t Add(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                      size_t n) {
+    return LimbsAdd(r, a, b, n);
+  }
+
+  static uint64_t AddCarry(uint64_t *r, const uint64_t *a, size_t n,
+                           uint64_t carry) {
+    return LimbsAddCarry(r, a, n, carry);
+  }
+
+  static uint64_t Sub(uint64_t *r, const uint64_t *a, const uint64_t *b,
+                      size_t n) {
+    return LimbsSub(r, a, b, n);
+  }
+
+  static void SubBorrow(uint64_t *r, const uint64_t *a, size_t n,
+                        uint64_t borrow) {
+    LimbsSubBorrow(r, a, n, borrow);
+  }
+
+  static int32_t Cmp(const uint64_t *a, const uint64_t *b, size_t n) {
+    return LimbsCmp(a, b, n);
+  }
+
+  static uint64_t MulSmall(uint64_t *r, const uint64_t *a, size_t n,
+                           uint64_t m) {
+    return LimbsMulSmall(r, a, n, m);
+  }
+
+  static constexpr uint64_t kMulWordMax = UINT64_MAX;
+  static constexpr uint64_t kMulWordFastMax = kLimbMulSmallMax;
+
+  static void MulWords(uint64_t *r, const uint64_t *a, size_t n,
+                       const uint64_t *m, size_t k) {
+    if (std::all_of(m, m + k, [](uint64_t w) { return w <= kMulWordFastMax; })) {
+      // SIMD pass per word beats a fused 128 bit pass
+      for (size_t j = 0; j < k; ++j, n += 2) {
+        r[n] = LimbsMulSmall(r, j == 0 ? a : r, n, m[j]);
+        r[n + 1] = 0;
+      }
+    } else {
+      LimbsMulWords(r, a, n, m, k);
+    }
+  }
+
+  static void Mul(uint64_t *r, const uint64_t *a, size_t n, const uint64_t *b,
+                  size_t m) {
+    if (n < m) {
+      std::swap(a, b);
+      std::swap(n, m);
+    }
+    if (m < kKaratsubaThreshold) {
+      LimbsMulBase(r, a, n, b, m);
+      return;
+    }
+
+    // scratch is kept per thread, so repeated products do not allocate
+    thread_local std::vector<uint64_t> scratch;
+    if (scratch.size() < KaratsubaScratch(n)) {
+      scratch.resize(KaratsubaScratch(n));
+    }
+    LimbsMulKaratsuba(r, a, n, b, m, scratch.data());
+  }
+
+  static uint64_t DivSmall(uint64_t *q, const uint64_t *a, size_t n,
+                           uint64_t d) {
+    return LimbsDivSmall(q, a, n, d);
+  }
+
+  static uint64_t DigitSum(const uint64_t *a, size_t n) {
+    return cpu_kernels().digit_sum(a, n);
+  }
+
+  //! Scalar on every path (no SIMD formatter, see limb_kernels.h)
+  static void Format(char *out, const uint64_t *a, size_t n) {
+    LimbsFormatScalar(out, a, n);
+  }
+};
+
+#endif  // LIMB_RADIX_H_
@@ -37,8 +37,8 @@
  *   number of time I had to iterate on vector is reduced; Loop inside loop is
  *   always something to watch for;
  *
- * Obs: I would break class on its own .cpp and .h file. but kept it all here
- *      for ease of reading.
+ * Obs: class now lives on its own header (name_book_list.h), so it can be
+ *      linked into other programs (see cellcrypt.h for the C interface).
  *
  * New changes:
  * - method IsConsistent() is executing for last element without any need, but
@@ -55,192 +55,30 @@
  *   little overhead. No need for a double linked list as std::list
  */
 
-#include <fstream>
+#include <cstring>
 #include <iostream>
-#include <vector>
+#include <string_view>
 
-/**
- * \brief NameBook class
- *
- * Stores, output data and check consistency of names
- */
-class NameBook {
- public:
-  /**
-   * \brief Default constructor
-   */
-  NameBook() : name_list_(), consistent_(true) {}
-
-  /**
-   * \brief Constructor by file of names
-   * \param file_name File with names (one by line)
-   */
-  explicit NameBook(const std::string &file_name)
-      : name_list_(), consistent_(true) {
-    ReadNames(file_name);
-  }
-
-  /**
-   * \brief Destructor
-   */
-  ~NameBook() = default;
-
-  /**
-   * \brief Read names feom file of names
-   * \param file_name File with names (one by line)
-   */
-  void ReadNames(const std::string &file_name) {
-    std::fstream f;
-    f.open(file_name);
-
-    std::string name{};
-
-    while (f >> name) {
-      if (!CheckNameConsistency(name)) {
-        consistent_ = false;
-      }
-      name_list_.push_back(name);
-    }
-
-    f.close();
-  }
-
-  /**
-   * \brief Get the name list
-   * \return Name list
-   */
-  const std::vector<std::string> &name_list() const { return name_list_; }
-
-  /**
-   * \brief Add name to name list
-   * \param name Name to be added to name list
-   */
-  void AddName(const std::string &name) {
-    if (!CheckNameConsistency(name)) {
-      consistent_ = false;
-    }
-
-    name_list_.push_back(name);
-  }
-
-  /**
-   * \brief Remove all names from name list
-   */
-  void ClearNames() {
-    name_list_.clear();
-    consistent_ = true;
-  }
-
-  /**
-   * \brief Get list name as string (one by line)
-   * \return List name as string
-   */
-  std::string to_string() const {
-    std::string names;
-
-    for (const auto &name : name_list_) {
-      names += name + "\n";
-    }
-
-    return names;
-  }
-
-  /**
-   * \brief Check is name list is consistent
-   *
-   * If no name begins with the same sequence of letters that makes up another
-   * whole name
-   *
-   * \return true is name list is consistent; false otherwise
-   */
-  bool IsConsistent() const {
-    for (uint32_t i = 0; i < name_list_.size(); ++i) {
-      const std::string name_1(name_list_[i]);
-
-      for (uint32_t j = i + 1; j < name_list_.size(); ++j) {
-        const std::string name_2 = (name_list_[j]);
-
-        if (CheckIfSubString(name_1, name_2)) {
-          return false;
-        }
-      }
-    }
-
-    return true;
-  }
-
-  /**
-   * \brief Check is name list is consistent
-   *
-   * If no name begins with the same sequence of letters that makes up another
-   * whole name
-   *
-   * \return true is name list is consistent; false otherwise
-   */
-  bool consistent() const { return consistent_; }
-
-  friend std::ostream &operator<<(std::ostream &o, const NameBook &name_book);
-
- private:
-  /**
-   * \brief Check if string are substring of each other
-   * \param name_1 First name
-   * \param name_2 Second name
-   * \return true if substring; false otherwise
-   */
-  bool CheckIfSubString(const std::string name_1,
-                        const std::string name_2) const {
-    // check if name_2 is a substring of name_1
-    uint32_t pos_1 = name_1.find(name_2);
-    if (pos_1 != std::string::npos && pos_1 == 0) {
-      return true;
-    }
-
-    // check if name_1 is a substring of name_2
-    uint32_t pos_2 = name_2.find(name_1);
-    if (pos_2 != std::string::npos && pos_2 == 0) {
-      return true;
-    }
-
-    return false;
-  }
-
-  /**
-   * \brief Check name consistency against name list
-   * \param name_1 First name
-   * \return true is name list is consistent with given name; false otherwise
-   */
-  bool CheckNameConsistency(const std::string name) {
-    for (const auto &name_in_l : name_list_) {
-      if (CheckIfSubString(name, name_in_l)) {
-        return false;
-      }
-    }
-
-    return true;
-  }
-
-  std::vector<std::string> name_list_;  //!< Name list
-  bool consistent_;  //!< Flag to indicate if name list is consistent
-};
-
-/**
- * \brief Stream output NameBook (one by line)
- * \return Stream output NameBook
- */
-std::ostream &operator<<(std::ostream &o, const NameBook &name_book) {
-  for (const auto &name : name_book.name_list_) {
-    o << name << "\n";
-  }
-
-  return o;
-}
+#include "alloc_profile.h"
+#include "name_book_list.h"
 
 /**
  * \brief Entry point of Factorial Hash Challenge
+ *
+ * --print-cpu-path prints the instruction set path picked for this CPU.
+ * A file that cannot be opened or read whole (truncated or corrupt compressed
+ * data) is reported instead of a verdict.
+ * Built with -DCELLCRYPT_ALLOC_PROFILE, heap allocations of every phase and
+ * their top call sites are printed to stderr at the end.
+ *
  * \return 0 on success; -1 on error
  */
-int main() {
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--print-cpu-path") == 0) {
+    std::cout << cpu_kernels().name << std::endl;
+    return 0;
+  }
+
   std::cout << "Enter file name with list of name: ";
 
   // since it was not clear how many names have to be handled, or when to stop
@@ -250,36 +88,42 @@ int main() {
   std::cin >> file_name;
 
   // constructed with name
-  // NameBook name_book{file_name};
+  // NameBookList name_book{file_name};
 
   // default constructed and read file
   /*
-     NameBook name_book;
+     NameBookList name_book;
      name_book.ReadNames(file_name);
   */
 
   // default constructed and add name by name
 
-  NameBook name_book;
-  std::fstream f;
-  f.open(file_name);
+  SetAllocPhase("read");
+  NameBookList name_book;
+  NameReader f(file_name);
 
-  std::string name{};
+  std::string_view name;
 
-  while (f >> name) {
+  SetAllocPhase("add");
+  while (f.Next(&name)) {
     name_book.AddName(name);
     // std::cout << "Adding " << name << "; Name book is consistent? "
     //         << (name_book.consistent() ? "true" : "false") << std::endl;
   }
+  if (f.failed()) {
+    std::cerr << "Cannot read " << file_name << std::endl;
+    return -1;
+  }
   std::cout << "Name book is consistent after loop? "
             << (name_book.consistent() ? "true" : "false") << std::endl;
 
-  f.close();
-
   // std::cout << "Names read: " << std::endl << name_book;
 
+  SetAllocPhase("check");
   std::cout << "Name book is consistent? "
             << (name_book.IsConsistent() ? "true" : "false") << std::endl;
 
+  PrintAllocProfile(std::cerr);
+
   return 0;
 }
@@ -0,0 +1,201 @@
+/**
+ * \brief Cellcrypt name book based on list
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef NAME_BOOK_LIST_H_
+#define NAME_BOOK_LIST_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpu_dispatch.h"
+#include "name_reader.h"
+
+/**
+ * \brief NameBookList class
+ *
+ * Stores, output data and check consistency of names
+ */
+class NameBookList {
+ public:
+  /**
+   * \brief Default constructor
+   */
+  NameBookList() : name_list_(), consistent_(true) {}
+
+  /**
+   * \brief Constructor by file of names
+   * \param file_name File with names (one by line)
+   */
+  explicit NameBookList(const std::string &file_name)
+      : name_list_(), consistent_(true) {
+    ReadNames(file_name);
+  }
+
+  /**
+   * \brief Destructor
+   */
+  ~NameBookList() = default;
+
+  /**
+   * \brief Read names feom file of names
+   * \param file_name File with names (one by line)
+   * \return true if the file was read whole; false if it could not be opened
+   *         or read (names read until then are added)
+   */
+  bool ReadNames(const std::string &file_name) {
+    NameReader f(file_name);
+    return ReadNamesFrom(&f);
+  }
+
+  /**
+   * \brief Read names from a reader (NameReader, CsvNameReader...)
+   * \param reader Reader with Next(std::string_view *) and failed()
+   * \return true if the reader got to the end; false if it failed
+   */
+  template <typename Reader>
+  bool ReadNamesFrom(Reader *reader) {
+    std::string_view name;
+
+    while (reader->Next(&name)) {
+      AddName(name);
+    }
+
+    return !reader->failed();
+  }
+
+  /**
+   * \brief Get the name list
+   * \return Name list
+   */
+  const std::vector<std::string> &name_list() const { return name_list_; }
+
+  /**
+   * \brief Add name to name list
+   * \param name Name to be added to name list
+   * \return true if name is consistent with name list; false otherwise
+   */
+  bool AddName(std::string_view name) {
+    const bool name_consistent = CheckNameConsistency(name);
+    if (!name_consistent) {
+      consistent_ = false;
+    }
+
+    name_list_.emplace_back(name);
+
+    return name_consistent;
+  }
+
+  /**
+   * \brief Remove all names from name list
+   */
+  void ClearNames() {
+    name_list_.clear();
+    consistent_ = true;
+  }
+
+  /**
+   * \brief Get list name as string (one by line)
+   * \return List name as string
+   */
+  std::string to_string() const {
+    std::string names;
+
+    for (const auto &name : name_list_) {
+      names += name + "\n";
+    }
+
+    return names;
+  }
+
+  /**
+   * \brief Check is name list is consistent
+   *
+   * If no name begins with the same sequence of letters that makes up another
+   * whole name
+   *
+   * \return true is name list is consistent; false otherwise
+   */
+  bool IsConsistent() const {
+    for (uint32_t i = 0; i < name_list_.size(); ++i) {
+      const std::string name_1(name_list_[i]);
+
+      for (uint32_t j = i + 1; j < name_list_.size(); ++j) {
+        const std::string name_2 = (name_list_[j]);
+
+        if (CheckIfSubString(name_1, name_2)) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Check is name list is consistent
+   *
+   * If no name begins with the same sequence of letters that makes up another
+   * whole name
+   *
+   * \return true is name list is consistent; false otherwise
+   */
+  bool consistent() const { return consistent_; }
+
+  friend std::ostream &operator<<(std::ostream &o,
+                                  const NameBookList &name_book);
+
+ private:
+  /**
+   * \brief Check if string are substring of each other
+   * \param name_1 First name
+   * \param name_2 Second name
+   * \return true if substring; false otherwise
+   */
+  bool CheckIfSubString(std::string_view name_1,
+                        std::string_view name_2) const {
+    // one begins with the other when they agree on all chars of the shorter
+    const size_t n = std::min(name_1.size(), name_2.size());
+
+    return cpu_kernels().common_prefix(name_1.data(), name_2.data(), n) == n;
+  }
+
+  /**
+   * \brief Check name consistency against name list
+   * \param name_1 First name
+   * \return true is name list is consistent with given name; false otherwise
+   */
+  bool CheckNameConsistency(std::string_view name) const {
+    for (const auto &name_in_l : name_list_) {
+      if (CheckIfSubString(name, name_in_l)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::vector<std::string> name_list_;  //!< Name list
+  bool consistent_;  //!< Flag to indicate if name list is consistent
+};
+
+/**
+ * \brief Stream output NameBookList (one by line)
+ * \return Stream output NameBookList
+ */
+inline std::ostream &operator<<(std::ostream &o,
+                                const NameBookList &name_book) {
+  for (const auto &name : name_book.name_list_) {
+    o << name << "\n";
+  }
+
+  return o;
+}
+
+#endif  // NAME_BOOK_LIST_H_
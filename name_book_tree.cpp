@@ -38,8 +38,8 @@
  * - If there are several similar or equal names memory can be saved with this
  *   approach;
  *
- * Obs: I would break class on its own .cpp and .h file. but kept it all here
- *      for ease of reading.
+ * Obs: class now lives on its own header (name_book_tree.h), so it can be
+ *      linked into other programs (see cellcrypt.h for the C interface).
  *
  * Obs1: This approach is more complex and error prone. A good unit test is
  * really needed;
@@ -49,226 +49,105 @@
  * letter may consume more memory;
  */
 
-#include <fstream>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
 
-/**
- * \brief Node class
- *
- * Node stores its data and all its possible children
- */
-class Node {
- public:
-  /**
-   * \brief Constructor by data
-   */
-  explicit Node(char c) : data_(c), num_children_(0) {
-    for (uint32_t i = 0; i < kMaxChildren; ++i) {
-      children_[i] = nullptr;
-    }
-  }
-
-  /**
-   * \bfief Destructor
-   */
-  ~Node() {
-    for (uint32_t i = 0; i < kMaxChildren; ++i) {
-      if (children_[i] != nullptr) {
-        delete children_[i];
-      }
-    }
-  }
-
-  /**
-   * \brief Find child node based on data
-   * \param c Data
-   * \return true if child found; false otherwise
-   */
-  bool FindChild(char c) const {
-    if (children_[IndexFromChar(c)] == nullptr) {
-      return true;
-    } else {
-      return false;
-    }
-  }
-
-  /**
-   * \brief Get child node based on data
-   * \param c Data
-   * \return Child node
-   */
-  Node *GetChild(char c) const { return children_[IndexFromChar(c)]; }
-
-  /**
-   * \brief Add a child node to this node (it does not check collision!)
-   * \brief node Child node
-   */
-  void AddChild(Node *node) {
-    int32_t index = IndexFromChar(node->data_);
-    children_[index] = node;
-    ++num_children_;
-  }
-
-  /**
-   * \brief Get the number of children of the node
-   * \return Number of children
-   */
-  uint8_t num_children() const { return num_children_; }
-
- private:
-  /**
-   * \brief Get index from char
-   * \return Index
-   */
-  int32_t IndexFromChar(char c) const {
-    return c - 97;  // 97 is the value of 'a' in ASCII
-  }
-
-  const static uint8_t kMaxChildren =
-      26;      //!< Max number of children (26 letter of alphabet)
-  char data_;  //!< Data char stored
-  Node *children_[kMaxChildren];  //!< Array of children nodes
-  uint8_t num_children_;          //!< Number of children of this node
-};
-
-enum class TreeRetCode { kOK, KCollision };
+#include "alloc_profile.h"
+#include "name_book_tree.h"
+#include "name_csv.h"
+#include "name_tail.h"
+#include "nibble_tree.h"
 
 /**
- * \brief WordTree class
- *
- * Creates a tree where each letter of word is a node
+ * \brief Read a name book from a reader
+ * \param reader Reader of names (NameReader, CsvNameReader)
+ * \param bulk Sort names and build the tree at once
+ * \param consistent Set to true if name book is consistent; false otherwise
+ * \return true if the file was read whole; false otherwise
  */
-class WordTree {
- public:
-  /**
-   * \brief Default constructor
-   */
-  WordTree() : root_('r') {}
-
-  /**
-   * \brief Add word to tree
-   * \param word Word
-   * \return TreeRetCode
-   */
-  TreeRetCode AddWord(const std::string &word);
-
- private:
-  /**
-   * \brief Add node to tree
-   * \param c Data
-   * \áram base_node Base (parent) node
-   * \return Node added
-   */
-  Node *AddNode(char c, Node *base_node);
-
-  Node root_;  //!< Root of word tree
-};
-
-Node *WordTree::AddNode(char c, Node *base_node) {
-  Node *node = base_node->GetChild(c);
-
-  if (node == nullptr) {
-    node = new Node(c);
-    base_node->AddChild(node);
-  } else {
-  }
+template <typename Book, typename Reader>
+bool ReadNameBook(Reader *reader, bool bulk, bool *consistent) {
+  Book name_book;
+  const bool read = name_book.ReadNamesFrom(reader, bulk);
+  *consistent = name_book.consistent();
 
-  return node;
+  return read;
 }
 
-TreeRetCode WordTree::AddWord(const std::string &word) {
-  TreeRetCode ret = TreeRetCode::kOK;
-
-  Node *base_node = &root_;
-
-  // get letter by letter
-  for (uint32_t i = 0; i < word.size(); ++i) {
-    Node *node = AddNode(word[i], base_node);
-
-    if (node->num_children() > 0 && i < word.size()) {
-      ret = TreeRetCode::KCollision;
-    }
-
-    base_node = node;
-  }
-
-  return ret;
+/**
+ * \brief Read a name book with the engine picked
+ * \param reader Reader of names
+ * \param nibble Names of any bytes on a NibbleTree
+ * \param bulk Sort names and build the tree at once
+ * \param consistent Set to true if name book is consistent; false otherwise
+ * \return true if the file was read whole; false otherwise
+ */
+template <typename Reader>
+bool ReadNameBook(Reader *reader, bool nibble, bool bulk, bool *consistent) {
+  return nibble ? ReadNameBook<BasicNameBookTree<NibbleTree>>(reader, bulk,
+                                                              consistent)
+                : ReadNameBook<NameBookTree>(reader, bulk, consistent);
 }
 
 /**
- * \brief NameBook class
- *
- * Stores, output data and check consistency of names
+ * \brief Add names appended to a file as they come, printing collisions
+ * \param file_name File followed
+ * \return -1 on error (runs until killed otherwise)
  */
-class NameBook {
- public:
-  /**
-   * \brief Default constructor
-   */
-  NameBook() : t_(), consistent_(true) {}
-
-  /**
-   * \brief Constructor by file of names
-   * \param file_name File with names (one by line)
-   */
-  explicit NameBook(const std::string &file_name) : t_(), consistent_(true) {
-    ReadNames(file_name);
+template <typename Book>
+int FollowNameBook(const std::string &file_name) {
+  Book name_book;
+  NameTail tail(file_name);
+  if (!tail.is_open()) {
+    std::cerr << "Cannot watch " << file_name << std::endl;
+    return -1;
   }
-
-  /**
-   * \brief Destructor
-   */
-  ~NameBook() = default;
-
-  /**
-   * \brief Read names feom file of names
-   * \param file_name File with names (one by line)
-   */
-  void ReadNames(const std::string &file_name) {
-    std::fstream f;
-    f.open(file_name);
-
-    std::string name{};
-
-    while (f >> name) {
-      if (t_.AddWord(name) == TreeRetCode::KCollision) {
-        consistent_ = false;
+  std::cout << std::endl;
+  for (;;) {
+    const bool ok = tail.Poll(-1, [&](std::string_view name) {
+      if (name_book.AddName(name) == TreeRetCode::KCollision) {
+        std::cout << "Collision: " << name << std::endl;
       }
-    }
-
-    f.close();
-  }
-
-  /**
-   * \brief Add name to name list
-   * \param name Name to be added to name list
-   */
-  void AddName(const std::string &name) {
-    if (t_.AddWord(name) == TreeRetCode::KCollision) {
-      consistent_ = false;
+    });
+    if (!ok) {
+      return -1;
     }
   }
-
-  /**
-   * \brief Check is name list is consistent
-   *
-   * If no name begins with the same sequence of letters that makes up another
-   * whole name
-   *
-   * \return true is name list is consistent; false otherwise
-   */
-  bool consistent() const { return consistent_; }
-
- private:
-  WordTree t_;
-  bool consistent_;  //!< Flag to indicate if name list is consistent
-};
+}
 
 /**
  * \brief Entry point of Factorial Hash Challenge
+ *
+ * --print-cpu-path prints the instruction set path picked for this CPU.
+ * --nibble checks names of any bytes (UTF-8, binary) on a NibbleTree instead
+ * of lowercase names on a WordTree.
+ * --bulk reads all names, sorts them and builds the tree in one pass
+ * (BuildFromSorted()) instead of adding them one by one.
+ * --check BATCH reads the book, then checks the names of file BATCH against it
+ * and each other (CheckBatch()), printing the colliding names.
+ * --csv COL / --tsv COL read names from column COL (0 based) of a CSV / TSV
+ * file (CsvNameReader), quoted fields included; --header skips its first row.
+ * Names with spaces need --nibble.
+ * --follow keeps the file open and adds names as they are appended to it
+ * (NameTail), printing each collision as soon as it is written; it runs until
+ * killed. It takes --nibble, not --csv, --tsv or --check.
+ * A file that cannot be opened or read whole (truncated or corrupt compressed
+ * data) is reported instead of a verdict.
+ * Built with -DCELLCRYPT_ALLOC_PROFILE, heap allocations of every phase and
+ * their top call sites are printed to stderr at the end.
+ *
  * \return 0 on success; -1 on error
  */
-int main() {
+int main(int argc, char **argv) {
+  if (argc > 1 && std::strcmp(argv[1], "--print-cpu-path") == 0) {
+    std::cout << cpu_kernels().name << std::endl;
+    return 0;
+  }
+
   std::cout << "Enter file name with list of name: ";
 
   // since it was not clear how many names have to be handled, or when to stop
@@ -277,34 +156,120 @@ int main() {
   std::string file_name;
   std::cin >> file_name;
 
+  bool nibble = false;
+  bool bulk = false;
+  bool follow = false;
+  bool header = false;
+  const char *batch_file = nullptr;
+  char delim = 0;
+  size_t column = 0;
+  for (int i = 1; i < argc; ++i) {
+    follow = follow || std::strcmp(argv[i], "--follow") == 0;
+    header = header || std::strcmp(argv[i], "--header") == 0;
+    if ((std::strcmp(argv[i], "--csv") == 0 ||
+         std::strcmp(argv[i], "--tsv") == 0) &&
+        i + 1 < argc) {
+      delim = argv[i][2] == 'c' ? ',' : '\t';
+      column = std::strtoull(argv[++i], nullptr, 10);
+    }
+    nibble = nibble || std::strcmp(argv[i], "--nibble") == 0;
+    bulk = bulk || std::strcmp(argv[i], "--bulk") == 0;
+    if (std::strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+      batch_file = argv[++i];
+    }
+  }
+  if (follow) {
+    if (delim != 0 || batch_file != nullptr) {
+      std::cerr << "--follow does not take --csv, --tsv or --check"
+                << std::endl;
+      return -1;
+    }
+    return nibble ? FollowNameBook<BasicNameBookTree<NibbleTree>>(file_name)
+                  : FollowNameBook<NameBookTree>(file_name);
+  }
+  if (batch_file != nullptr) {
+    SetAllocPhase("read");
+    NameBookTree name_book;
+    if (!name_book.ReadNames(file_name, bulk)) {
+      std::cerr << "Cannot read " << file_name << std::endl;
+      return -1;
+    }
+    std::vector<std::string> batch;
+    NameReader f(batch_file);
+    std::string_view name;
+    while (f.Next(&name)) {
+      batch.emplace_back(name);
+    }
+    if (f.failed()) {
+      std::cerr << "Cannot read " << batch_file << std::endl;
+      return -1;
+    }
+
+    SetAllocPhase("check");
+    std::vector<std::string> conflicts;
+    const bool ok = name_book.CheckBatch(batch, &conflicts);
+    for (const std::string &c : conflicts) {
+      std::cout << "Collision: " << c << std::endl;
+    }
+    std::cout << "Batch is consistent with name book? "
+              << (ok ? "true" : "false") << std::endl;
+    PrintAllocProfile(std::cerr);
+    return 0;
+  }
+  if (nibble || bulk || delim != 0) {
+    SetAllocPhase("add");
+    bool consistent = false;
+    bool read = false;
+    if (delim != 0) {
+      CsvNameReader f(file_name, column, delim, header);
+      read = ReadNameBook(&f, nibble, bulk, &consistent);
+    } else {
+      NameReader f(file_name);
+      read = ReadNameBook(&f, nibble, bulk, &consistent);
+    }
+    if (!read) {
+      std::cerr << "Cannot read " << file_name << std::endl;
+      return -1;
+    }
+    std::cout << "Name book is consistent after loop? "
+              << (consistent ? "true" : "false") << std::endl;
+    PrintAllocProfile(std::cerr);
+    return 0;
+  }
+
   // constructed with name
-  // NameBook name_book{file_name};
+  // NameBookTree name_book{file_name};
 
   // default constructed and read file
   /*
-     NameBook name_book;
+     NameBookTree name_book;
      name_book.ReadNames(file_name);
   */
 
   // default constructed and add name by name
 
-  NameBook name_book;
-  std::fstream f;
-  f.open(file_name);
+  SetAllocPhase("read");
+  NameBookTree name_book;
+  NameReader f(file_name);
 
-  std::string name{};
+  std::string_view name;
 
-  while (f >> name) {
+  SetAllocPhase("add");
+  while (f.Next(&name)) {
     name_book.AddName(name);
     // std::cout << "Adding " << name << "; Name book is consistent? "
     //         << (name_book.consistent() ? "true" : "false") << std::endl;
   }
+  if (f.failed()) {
+    std::cerr << "Cannot read " << file_name << std::endl;
+    return -1;
+  }
   std::cout << "Name book is consistent after loop? "
             << (name_book.consistent() ? "true" : "false") << std::endl;
 
-  f.close();
-
   // std::cout << "Names read: " << std::endl << name_book;
 
+  PrintAllocProfile(std::cerr);
+
   return 0;
 }
@@ -0,0 +1,315 @@
+/**
+ * \brief Cellcrypt name book based on tree
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef NAME_BOOK_TREE_H_
+#define NAME_BOOK_TREE_H_
+
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "name_reader.h"
+#include "word_tree.h"
+
+/**
+ * \brief NameBookTree class
+ *
+ * Stores, output data and check consistency of names in a Tree (WordTree of
+ * lowercase names by default; BasicWordTree of another alphabet for other
+ * names, see tree_alphabet.h)
+ */
+template <typename Tree = WordTree>
+class BasicNameBookTree {
+ public:
+  /**
+   * \brief Default constructor
+   */
+  BasicNameBookTree()
+      : t_(), consistent_(true), recheck_(false), empty_(true) {}
+
+  /**
+   * \brief Constructor by file of names
+   * \param file_name File with names (one by line)
+   */
+  explicit BasicNameBookTree(const std::string &file_name)
+      : t_(), consistent_(true), recheck_(false), empty_(true) {
+    ReadNames(file_name);
+  }
+
+  /**
+   * \brief Destructor
+   */
+  ~BasicNameBookTree() = default;
+
+  /**
+   * \brief Read names feom file of names
+   *
+   * Names are added to those in the book. A bulk load adds them all at once
+   * instead of name by name: they are read, sorted in letter order of the tree
+   * (SortWords(), so 'A' and 'a' of a folded alphabet sort together), built
+   * into a tree of their own (Tree::BuildFromSorted()) and merged into the
+   * book (Tree::Merge()).
+   * Trees without Merge() are built in place when the book is empty, and
+   * otherwise take the sorted names one by one.
+   *
+   * \param file_name File with names (one by line)
+   * \param bulk Add names with a bulk load
+   * \return true if the file was read whole; false if it could not be opened
+   *         or read (names read until then are added)
+   */
+  bool ReadNames(const std::string &file_name, bool bulk = false) {
+    NameReader f(file_name);
+    return ReadNamesFrom(&f, bulk);
+  }
+
+  /**
+   * \brief Read names from a reader (NameReader, CsvNameReader...)
+   * \param reader Reader with Next(std::string_view *) and failed()
+   * \param bulk Add names with a bulk load (see ReadNames())
+   * \return true if the reader got to the end; false if it failed
+   */
+  template <typename Reader>
+  bool ReadNamesFrom(Reader *reader, bool bulk = false) {
+    std::string_view name;
+
+    if (!bulk) {
+      while (reader->Next(&name)) {
+        AddName(name);
+      }
+      return !reader->failed();
+    }
+
+    // names go to one buffer; views are taken once it stops growing
+    std::string chars;
+    std::vector<std::pair<size_t, size_t>> spans;
+    while (reader->Next(&name)) {
+      spans.emplace_back(chars.size(), name.size());
+      chars.append(name.data(), name.size());
+    }
+    std::vector<std::string_view> names;
+    names.reserve(spans.size());
+    for (const auto &span : spans) {
+      names.emplace_back(chars.data() + span.first, span.second);
+    }
+    SortWords<typename Tree::Letters>(&names);
+
+    consistent_ = AddSorted(names, 0) && consistent();
+    recheck_ = false;
+    empty_ = empty_ && names.empty();
+
+    return !reader->failed();
+  }
+
+  /**
+   * \brief Add name to name list
+   * \param name Name to be added to name list
+   * \return TreeRetCode; names with kInvalidChar are not added
+   */
+  TreeRetCode AddName(std::string_view name) {
+    const TreeRetCode ret = t_.AddWord(name);
+    empty_ = false;
+    if (ret == TreeRetCode::KCollision) {
+      consistent_ = false;
+      recheck_ = false;
+    }
+
+    return ret;
+  }
+
+  /**
+   * \brief Remove name from name list (however many times it was added)
+   *
+   * Removing names can only make an inconsistent list consistent: then the
+   * whole tree is checked again, once, on the next consistent() call.
+   *
+   * \param name Name to be removed
+   * \return true if name was in name list; false otherwise
+   */
+  bool RemoveName(std::string_view name) {
+    if (!t_.RemoveWord(name)) {
+      return false;
+    }
+    if (!consistent_) {
+      recheck_ = true;
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Call a function on every name, once per time it was added
+   * \param fn Function of a std::string_view (valid during the call)
+   */
+  template <typename Fn>
+  void ForEachName(Fn &&fn) const {
+    t_.ForEachWord(fn);
+  }
+
+  /**
+   * \brief Move all names of another name book into this one
+   *
+   * Trees are merged node by node (Tree::Merge()), not name by name.
+   *
+   * \param other Name book to take names from (left empty and consistent)
+   * \param threads Number of threads for the merge
+   * \param conflicts If not nullptr, gets the names colliding across books
+   * \return true if name list is consistent after the merge; false otherwise
+   */
+  bool Merge(BasicNameBookTree &&other, unsigned threads = 1,
+             std::vector<std::string> *conflicts = nullptr) {
+    const TreeRetCode ret = t_.Merge(std::move(other.t_), threads, conflicts);
+    consistent_ = consistent() && other.consistent() &&
+                  ret != TreeRetCode::KCollision;
+    recheck_ = false;
+    other.consistent_ = true;
+    other.recheck_ = false;
+
+    return consistent_;
+  }
+
+  /**
+   * \brief Check if names of this and another name book would be consistent
+   *        together, changing neither
+   * \param other Name book to check against
+   * \param threads Number of threads for the check
+   * \param conflicts If not nullptr, gets the names colliding across books
+   * \return true if the union of both name lists is consistent; false
+   *         otherwise
+   */
+  bool CheckUnion(const BasicNameBookTree &other, unsigned threads = 1,
+                  std::vector<std::string> *conflicts = nullptr) const {
+    return t_.CheckUnion(other.t_, threads, conflicts) !=
+               TreeRetCode::KCollision &&
+           consistent() && other.consistent();
+  }
+
+  /**
+   * \brief Check a batch of names against the book, changing nothing
+   *
+   * Only the batch goes to a tree: it is sorted in letter order of the tree
+   * (SortWords()) and built at once (collisions within the batch are between
+   * sorted neighbours, compared letter by letter), then walked together with
+   * the book tree (Tree::CheckUnion()), which only descends where both trees
+   * go. Cost follows the batch size, not the book size. Names the book would
+   * not add (kInvalidChar) are skipped.
+   *
+   * \param names Names (std::string_view convertible)
+   * \param conflicts If not nullptr, gets the shorter name of each colliding
+   *        pair: first those within the batch (sorted), then those against the
+   *        book (a book name or a batch name, in order)
+   * \return true if no name collides with the book or another name of the
+   *         batch; false otherwise
+   */
+  template <typename Range>
+  bool CheckBatch(const Range &names,
+                  std::vector<std::string> *conflicts = nullptr) const {
+    std::vector<std::string_view> sorted(std::begin(names), std::end(names));
+    SortWords<typename Tree::Letters>(&sorted);
+
+    bool first = true;
+    std::string_view prev;
+    const bool ok = ForEachSortedWord<typename Tree::Letters>(
+                        sorted, Tree::IsValidWord,
+                        [&](std::string_view name, size_t common) {
+                          if (!first && common == prev.size() &&
+                              conflicts != nullptr) {
+                            conflicts->emplace_back(prev);
+                          }
+                          first = false;
+                          prev = name;
+                        }) != TreeRetCode::KCollision;
+
+    Tree batch;
+    batch.BuildFromSorted(sorted);
+
+    return batch.CheckUnion(t_, 1, conflicts) != TreeRetCode::KCollision &&
+           ok;
+  }
+
+  /**
+   * \brief Remove all names from name list
+   */
+  void ClearNames() {
+    t_.Clear();
+    consistent_ = true;
+    recheck_ = false;
+    empty_ = true;
+  }
+
+  /**
+   * \brief Check is name list is consistent
+   *
+   * If no name begins with the same sequence of letters that makes up another
+   * whole name
+   *
+   * \return true is name list is consistent; false otherwise
+   */
+  bool consistent() const {
+    if (recheck_) {
+      consistent_ = Recheck(t_, 0);
+      recheck_ = false;
+    }
+
+    return consistent_;
+  }
+
+ private:
+  /**
+   * \brief Add sorted names at once: built apart, then merged
+   * \return false if they collide with each other or with the book
+   */
+  template <typename T = Tree>
+  auto AddSorted(const std::vector<std::string_view> &names, int)
+      -> decltype(std::declval<T &>().Merge(std::declval<T &&>()), bool()) {
+    Tree batch;
+    const bool ok = batch.BuildFromSorted(names) != TreeRetCode::KCollision;
+
+    return t_.Merge(std::move(batch)) != TreeRetCode::KCollision && ok;
+  }
+
+  /**
+   * \brief Add sorted names, for trees without Merge()
+   * \return false if they collide with each other or with the book
+   */
+  bool AddSorted(const std::vector<std::string_view> &names, long) {
+    if (empty_) {
+      return t_.BuildFromSorted(names) != TreeRetCode::KCollision;
+    }
+    bool ok = true;
+    for (const std::string_view name : names) {
+      ok = t_.AddWord(name) != TreeRetCode::KCollision && ok;
+    }
+
+    return ok;
+  }
+
+  /**
+   * \brief Check the whole tree again; only trees with RemoveWord() (and
+   *        IsConsistent()) ever need it
+   */
+  template <typename T>
+  static auto Recheck(const T &t, int) -> decltype(t.IsConsistent()) {
+    return t.IsConsistent();
+  }
+  template <typename T>
+  static bool Recheck(const T &, long) {
+    return false;
+  }
+
+  Tree t_;                   //!< Names
+  mutable bool consistent_;  //!< Flag to indicate if name list is consistent
+  mutable bool recheck_;     //!< Flag: names were removed, check tree again
+  bool empty_;  //!< No name added since construction or ClearNames()
+};
+
+/**
+ * \brief Name book of lowercase names
+ */
+using NameBookTree = BasicNameBookTree<>;
+
+#endif  // NAME_BOOK_TREE_H_
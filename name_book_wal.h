@@ -0,0 +1,648 @@
+/**
+ * \brief Cellcrypt name book write-ahead log
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Name book kept on disk as a snapshot plus a log of later changes.
+ *
+ * Files in the book directory, G a generation number:
+ * - log.G: records of added and removed names, appended and synced in
+ *   batches. A record is a CRC-32C, the name length, the operation and the
+ *   name bytes (host byte order); replay stops at the first record that is
+ *   short or fails its checksum (a torn write at crash), and the last log is
+ *   cut back there before appending again;
+ * - snapshot.G: an add record per name, once per time added, of the book with
+ *   every log before G folded in. It is written under a temporary name, synced
+ *   and renamed, so a snapshot is either whole or absent.
+ *
+ * Opening loads the newest snapshot and replays the logs from its generation
+ * on. Compact() closes the log being appended and starts the next one; a
+ * background thread then folds the newest snapshot and the closed logs into a
+ * new snapshot, reading only files, and removes what it replaces.
+ *
+ * Names are stored by length, so any name the tree takes (empty, or with
+ * white space in a NibbleTree) comes back as it went in.
+ */
+
+#ifndef NAME_BOOK_WAL_H_
+#define NAME_BOOK_WAL_H_
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "name_book_tree.h"
+
+enum class WalRetCode { kOK, kOpenFailed, kReadFailed, kWriteFailed };
+
+/**
+ * \brief Change recorded in a log
+ */
+enum class WalOp : uint8_t { kAdd = 1, kRemove = 2 };
+
+//! Bytes of a record before the name: CRC-32C, name length, operation
+constexpr size_t kWalHeaderSize = 4 + 4 + 1;
+
+/**
+ * \brief CRC-32C (Castagnoli) of bytes
+ * \param data Bytes
+ * \param len Number of bytes
+ * \return Checksum
+ */
+inline uint32_t Crc32c(const char *data, size_t len) {
+  static const std::array<uint32_t, 256> table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k) {
+        c = (c & 1) != 0 ? (c >> 1) ^ 0x82f63b78u : c >> 1;
+      }
+      t[i] = c;
+    }
+    return t;
+  }();
+
+  uint32_t crc = 0xffffffffu;
+  for (size_t i = 0; i < len; ++i) {
+    crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+  }
+
+  return crc ^ 0xffffffffu;
+}
+
+/**
+ * \brief Write all bytes to a file descriptor
+ * \return true on success; false on error
+ */
+inline bool WalWriteAll(int fd, const char *data, size_t len) {
+  while (len > 0) {
+    const ssize_t got = write(fd, data, len);
+    if (got < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += got;
+    len -= static_cast<size_t>(got);
+  }
+
+  return true;
+}
+
+/**
+ * \brief Sync a directory, so renames and new files in it are durable
+ * \return true on success; false on error
+ */
+inline bool SyncDirectory(const std::string &dir) {
+  const int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    return false;
+  }
+  const bool ok = fsync(fd) == 0;
+  close(fd);
+
+  return ok;
+}
+
+/**
+ * \brief Appends records to a log file
+ *
+ * Records are buffered; Sync() writes them and waits for the disk, so many
+ * records share one fdatasync().
+ */
+class NameLogWriter {
+ public:
+  NameLogWriter() : fd_(-1) {}
+
+  NameLogWriter(const NameLogWriter &) = delete;
+  NameLogWriter &operator=(const NameLogWriter &) = delete;
+
+  /**
+   * \brief Destructor (records not synced yet are written, not synced)
+   */
+  ~NameLogWriter() { Close(); }
+
+  /**
+   * \brief Open a log file to append to (created if missing; sync its
+   *        directory before relying on a new file)
+   * \param file_name Log file
+   * \param size Bytes of the file to keep; those past it (a torn record) go
+   * \return kOK; kOpenFailed or kWriteFailed otherwise
+   */
+  WalRetCode Open(const std::string &file_name, size_t size) {
+    Close();
+    fd_ = open(file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) {
+      return WalRetCode::kOpenFailed;
+    }
+    if (ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+      return WalRetCode::kWriteFailed;
+    }
+
+    return WalRetCode::kOK;
+  }
+
+  /**
+   * \brief Add a record to the buffer
+   * \param op Operation
+   * \param name Name
+   */
+  void Append(WalOp op, std::string_view name) {
+    const size_t start = buf_.size();
+    const uint32_t length = static_cast<uint32_t>(name.size());
+    buf_.resize(start + kWalHeaderSize);
+    std::memcpy(&buf_[start + 4], &length, 4);
+    buf_[start + 8] = static_cast<char>(op);
+    buf_.append(name.data(), name.size());
+
+    const uint32_t crc =
+        Crc32c(buf_.data() + start + 4, buf_.size() - start - 4);
+    std::memcpy(&buf_[start], &crc, 4);
+    ++pending_;
+  }
+
+  /**
+   * \brief Write buffered records, without waiting for the disk
+   * \return kOK; kWriteFailed otherwise
+   */
+  WalRetCode Write() {
+    const bool ok = buf_.empty() || WalWriteAll(fd_, buf_.data(), buf_.size());
+    unsynced_ = unsynced_ || !buf_.empty();
+    buf_.clear();
+    pending_ = 0;
+
+    return ok ? WalRetCode::kOK : WalRetCode::kWriteFailed;
+  }
+
+  /**
+   * \brief Write buffered records and wait for the disk
+   * \return kOK; kWriteFailed otherwise
+   */
+  WalRetCode Sync() {
+    bool ok = Write() == WalRetCode::kOK;
+    if (unsynced_) {
+      ok = fdatasync(fd_) == 0 && ok;
+      unsynced_ = false;
+    }
+
+    return ok ? WalRetCode::kOK : WalRetCode::kWriteFailed;
+  }
+
+  /**
+   * \brief Write buffered records and close the file
+   * \return kOK; kWriteFailed otherwise
+   */
+  WalRetCode Close() {
+    WalRetCode ret = WalRetCode::kOK;
+    if (fd_ >= 0) {
+      ret = Write();
+      if (close(fd_) != 0) {
+        ret = WalRetCode::kWriteFailed;
+      }
+      fd_ = -1;
+    }
+    buf_.clear();
+    pending_ = 0;
+    unsynced_ = false;
+
+    return ret;
+  }
+
+  //! Bytes buffered since the last Write()
+  size_t buffered() const { return buf_.size(); }
+
+  //! Records buffered since the last Write()
+  size_t pending() const { return pending_; }
+
+ private:
+  int fd_;                 //!< Log file; -1 if none
+  std::string buf_;        //!< Records not written yet
+  size_t pending_ = 0;     //!< Records in buf_
+  bool unsynced_ = false;  //!< Records written since the last fdatasync()
+};
+
+/**
+ * \brief Replay the records of a log file
+ * \param file_name Log file
+ * \param fn Function of a WalOp and a std::string_view, called per record
+ * \param size Out: bytes of whole records with a good checksum
+ * \return kOK (a missing file has no records); kReadFailed otherwise
+ */
+template <typename Fn>
+inline WalRetCode ReplayNameLog(const std::string &file_name, Fn &&fn,
+                                size_t *size) {
+  *size = 0;
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return errno == ENOENT ? WalRetCode::kOK : WalRetCode::kReadFailed;
+  }
+  std::string data;
+  char block[1 << 16];
+  for (;;) {
+    const ssize_t got = read(fd, block, sizeof(block));
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got < 0) {
+      close(fd);
+      return WalRetCode::kReadFailed;
+    }
+    if (got == 0) {
+      break;
+    }
+    data.append(block, static_cast<size_t>(got));
+  }
+  close(fd);
+
+  size_t pos = 0;
+  while (data.size() - pos >= kWalHeaderSize) {
+    uint32_t crc = 0;
+    uint32_t length = 0;
+    std::memcpy(&crc, &data[pos], 4);
+    std::memcpy(&length, &data[pos + 4], 4);
+    const WalOp op = static_cast<WalOp>(data[pos + 8]);
+    if (data.size() - pos - kWalHeaderSize < length ||
+        Crc32c(&data[pos + 4], kWalHeaderSize - 4 + length) != crc ||
+        (op != WalOp::kAdd && op != WalOp::kRemove)) {
+      break;
+    }
+    fn(op, std::string_view(&data[pos + kWalHeaderSize], length));
+    pos += kWalHeaderSize + length;
+  }
+  *size = pos;
+
+  return WalRetCode::kOK;
+}
+
+/**
+ * \brief Name book persisted by a write-ahead log and snapshots
+ *
+ * Every AddName() and RemoveName() is logged; records are synced every
+ * sync_batch of them, or on Sync(). Changes since the last sync may be lost at
+ * crash, never half applied.
+ */
+template <typename Tree = WordTree>
+class BasicDurableNameBook {
+ public:
+  /**
+   * \brief Constructor by directory (call Open() before use)
+   * \param dir Book directory (must exist)
+   * \param sync_batch Records per fdatasync()
+   */
+  explicit BasicDurableNameBook(std::string dir, size_t sync_batch = 256)
+      : dir_(std::move(dir)),
+        sync_batch_(sync_batch == 0 ? 1 : sync_batch),
+        snapshot_gen_(0),
+        log_gen_(0),
+        status_(WalRetCode::kOK),
+        compact_status_(WalRetCode::kOK) {}
+
+  BasicDurableNameBook(const BasicDurableNameBook &) = delete;
+  BasicDurableNameBook &operator=(const BasicDurableNameBook &) = delete;
+
+  /**
+   * \brief Destructor: waits for compaction and syncs the log
+   */
+  ~BasicDurableNameBook() {
+    WaitCompaction();
+    Sync();
+  }
+
+  /**
+   * \brief Load newest snapshot and replay logs after it
+   * \return kOK; error code otherwise
+   */
+  WalRetCode Open() {
+    WaitCompaction();
+    book_.ClearNames();
+
+    uint64_t snapshot = 0;
+    uint64_t log = 0;
+    std::vector<std::string> stale;
+    if (!ListGenerations(&snapshot, &log, &stale)) {
+      return WalRetCode::kOpenFailed;
+    }
+    // files a finished compaction replaced, left by a crash before removal
+    for (const std::string &file : stale) {
+      unlink((dir_ + "/" + file).c_str());
+    }
+
+    WalRetCode ret = LoadGenerations(&book_, snapshot, std::max(snapshot, log),
+                                     &log_size_);
+    if (ret != WalRetCode::kOK) {
+      return ret;
+    }
+    snapshot_gen_ = snapshot;
+    log_gen_ = std::max(snapshot, log);
+    ret = OpenLog(log_gen_, log_size_);
+    status_ = ret;
+
+    return ret;
+  }
+
+  /**
+   * \brief Add name, logging it
+   * \param name Name to be added
+   * \return TreeRetCode; names with kInvalidChar are neither added nor logged
+   */
+  TreeRetCode AddName(std::string_view name) {
+    const TreeRetCode ret = book_.AddName(name);
+    if (ret != TreeRetCode::kInvalidChar) {
+      Log(WalOp::kAdd, name);
+    }
+
+    return ret;
+  }
+
+  /**
+   * \brief Remove name, logging it
+   * \param name Name to be removed
+   * \return true if name was in book; false otherwise (nothing logged)
+   */
+  bool RemoveName(std::string_view name) {
+    if (!book_.RemoveName(name)) {
+      return false;
+    }
+    Log(WalOp::kRemove, name);
+
+    return true;
+  }
+
+  /**
+   * \brief Make every change so far durable
+   * \return kOK; kWriteFailed otherwise (also kept in status())
+   */
+  WalRetCode Sync() {
+    const WalRetCode ret = writer_.Sync();
+    if (ret != WalRetCode::kOK) {
+      status_ = ret;
+    }
+
+    return ret;
+  }
+
+  /**
+   * \brief Start folding the logs into a new snapshot in the background
+   *
+   * The log is synced and a new one started; a compaction still running is
+   * waited for first.
+   *
+   * \return kOK if started; error code otherwise
+   */
+  WalRetCode Compact() {
+    WaitCompaction();
+    WalRetCode ret = Sync();
+    if (ret != WalRetCode::kOK) {
+      return ret;
+    }
+    const uint64_t last = log_gen_;
+    ret = OpenLog(last + 1, 0);
+    if (ret != WalRetCode::kOK) {
+      status_ = ret;
+      return ret;
+    }
+    log_gen_ = last + 1;
+    log_size_ = 0;
+
+    compactor_ = std::thread([this, last] {
+      compact_status_ = Fold(snapshot_gen_, last);
+      if (compact_status_ == WalRetCode::kOK) {
+        snapshot_gen_ = last + 1;
+      }
+    });
+
+    return WalRetCode::kOK;
+  }
+
+  /**
+   * \brief Wait for a running compaction
+   * \return Result of the last compaction
+   */
+  WalRetCode WaitCompaction() {
+    if (compactor_.joinable()) {
+      compactor_.join();
+    }
+
+    return compact_status_;
+  }
+
+  //! Name book in memory
+  const BasicNameBookTree<Tree> &book() const { return book_; }
+
+  //! Check if name book is consistent
+  bool consistent() const { return book_.consistent(); }
+
+  //! First log error, kOK if none (changes after it may not be durable)
+  WalRetCode status() const { return status_; }
+
+ private:
+  std::string LogFile(uint64_t gen) const {
+    return dir_ + "/log." + std::to_string(gen);
+  }
+
+  std::string SnapshotFile(uint64_t gen) const {
+    return dir_ + "/snapshot." + std::to_string(gen);
+  }
+
+  /**
+   * \brief Open a log to append to, and make its directory entry durable
+   * \param gen Log generation
+   * \param size Good bytes of the log
+   * \return kOK; error code otherwise
+   */
+  WalRetCode OpenLog(uint64_t gen, size_t size) {
+    const WalRetCode ret = writer_.Open(LogFile(gen), size);
+    if (ret != WalRetCode::kOK) {
+      return ret;
+    }
+
+    return SyncDirectory(dir_) ? WalRetCode::kOK : WalRetCode::kWriteFailed;
+  }
+
+  /**
+   * \brief Find newest snapshot and log generations
+   * \param snapshot Out: newest snapshot generation (0 if none)
+   * \param log Out: newest log generation (0 if none)
+   * \param stale Out: files older than the newest snapshot, and temporary
+   *        snapshots of a compaction cut short
+   * \return true on success; false if directory cannot be read
+   */
+  bool ListGenerations(uint64_t *snapshot, uint64_t *log,
+                       std::vector<std::string> *stale) const {
+    DIR *d = opendir(dir_.c_str());
+    if (d == nullptr) {
+      return false;
+    }
+    std::vector<std::pair<std::string, uint64_t>> files;
+    while (const dirent *e = readdir(d)) {
+      const char *name = e->d_name;
+      if (std::strncmp(name, "tmp.", 4) == 0) {
+        stale->emplace_back(name);
+        continue;
+      }
+      const char *dot = std::strchr(name, '.');
+      if (dot == nullptr || dot[1] < '0' || dot[1] > '9') {
+        continue;
+      }
+      const uint64_t gen = std::strtoull(dot + 1, nullptr, 10);
+      if (std::strncmp(name, "snapshot.", 9) == 0) {
+        *snapshot = std::max(*snapshot, gen);
+      } else if (std::strncmp(name, "log.", 4) == 0) {
+        *log = std::max(*log, gen);
+      } else {
+        continue;
+      }
+      files.emplace_back(name, gen);
+    }
+    closedir(d);
+
+    for (const auto &file : files) {
+      if (file.second < *snapshot) {
+        stale->push_back(file.first);
+      }
+    }
+
+    return true;
+  }
+
+  /**
+   * \brief Load a snapshot and replay the logs after it
+   * \param book Book to load into (empty)
+   * \param snapshot Snapshot generation (missing file: empty book)
+   * \param last Last log generation to replay
+   * \param log_size Out: good bytes of the last log
+   * \return kOK; kReadFailed otherwise
+   */
+  WalRetCode LoadGenerations(BasicNameBookTree<Tree> *book,
+                             uint64_t snapshot, uint64_t last,
+                             size_t *log_size) const;
+
+  /**
+   * \brief Fold a snapshot and logs into the next snapshot (files only)
+   * \param snapshot Snapshot generation
+   * \param last Last log generation to fold
+   * \return kOK; error code otherwise
+   */
+  WalRetCode Fold(uint64_t snapshot, uint64_t last) const;
+
+  /**
+   * \brief Log a change, syncing once a batch is full
+   */
+  void Log(WalOp op, std::string_view name) {
+    writer_.Append(op, name);
+    if (writer_.pending() >= sync_batch_) {
+      Sync();
+    }
+  }
+
+  std::string dir_;                //!< Book directory
+  size_t sync_batch_;              //!< Records per fdatasync()
+  BasicNameBookTree<Tree> book_;   //!< Names in memory
+  NameLogWriter writer_;           //!< Log being appended
+  uint64_t snapshot_gen_;          //!< Newest snapshot generation
+  uint64_t log_gen_;               //!< Generation of the log being appended
+  size_t log_size_ = 0;            //!< Bytes of log being appended at open
+  WalRetCode status_;              //!< First log error
+  WalRetCode compact_status_;      //!< Result of the last compaction
+  std::thread compactor_;          //!< Running compaction
+};
+
+/**
+ * \brief Durable name book of lowercase names
+ */
+using DurableNameBook = BasicDurableNameBook<>;
+
+template <typename Tree>
+inline WalRetCode BasicDurableNameBook<Tree>::LoadGenerations(
+    BasicNameBookTree<Tree> *book, uint64_t snapshot, uint64_t last,
+    size_t *log_size) const {
+  auto apply = [book](WalOp op, std::string_view name) {
+    if (op == WalOp::kAdd) {
+      book->AddName(name);
+    } else {
+      book->RemoveName(name);
+    }
+  };
+
+  // generation 0 is never a snapshot: the book starts empty
+  if (snapshot > 0) {
+    // a snapshot is renamed in whole: it must be there, with no torn record
+    const std::string file = SnapshotFile(snapshot);
+    struct stat st;
+    size_t size = 0;
+    if (stat(file.c_str(), &st) != 0 ||
+        ReplayNameLog(file, apply, &size) != WalRetCode::kOK ||
+        size != static_cast<size_t>(st.st_size)) {
+      return WalRetCode::kReadFailed;
+    }
+  }
+
+  *log_size = 0;
+  for (uint64_t gen = snapshot; gen <= last; ++gen) {
+    const WalRetCode ret = ReplayNameLog(LogFile(gen), apply, log_size);
+    if (ret != WalRetCode::kOK) {
+      return ret;
+    }
+  }
+
+  return WalRetCode::kOK;
+}
+
+template <typename Tree>
+inline WalRetCode BasicDurableNameBook<Tree>::Fold(uint64_t snapshot,
+                                                  uint64_t last) const {
+  BasicNameBookTree<Tree> book;
+  size_t log_size = 0;
+  WalRetCode ret = LoadGenerations(&book, snapshot, last, &log_size);
+  if (ret != WalRetCode::kOK) {
+    return ret;
+  }
+
+  const std::string file = SnapshotFile(last + 1);
+  const std::string tmp = dir_ + "/tmp.snapshot." + std::to_string(last + 1);
+  NameLogWriter writer;
+  ret = writer.Open(tmp, 0);
+  if (ret != WalRetCode::kOK) {
+    unlink(tmp.c_str());
+    return ret;
+  }
+  bool ok = true;
+  book.ForEachName([&](std::string_view name) {
+    writer.Append(WalOp::kAdd, name);
+    if (writer.buffered() >= NameReader::kBlockSize) {
+      ok = writer.Write() == WalRetCode::kOK && ok;
+    }
+  });
+  ok = writer.Sync() == WalRetCode::kOK && ok;
+  ok = writer.Close() == WalRetCode::kOK && ok;
+  if (!ok || rename(tmp.c_str(), file.c_str()) != 0 || !SyncDirectory(dir_)) {
+    unlink(tmp.c_str());
+    return WalRetCode::kWriteFailed;
+  }
+
+  // the new snapshot stands for all of these now
+  unlink(SnapshotFile(snapshot).c_str());
+  for (uint64_t gen = snapshot; gen <= last; ++gen) {
+    unlink(LogFile(gen).c_str());
+  }
+
+  return WalRetCode::kOK;
+}
+
+#endif  // NAME_BOOK_WAL_H_
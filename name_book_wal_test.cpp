@@ -0,0 +1,276 @@
+/**
+ * \brief Cellcrypt durable name book test
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Checks DurableNameBook against a name count map kept in memory.
+ *
+ * - random: rounds of random AddName() and RemoveName() calls (empty names
+ *   included), Compact() now and then, each round on a book opened again from
+ *   its directory; names, counts and consistency must match the map after
+ *   every reopen;
+ * - torn tail: the last record of the log is cut short, or followed by
+ *   garbage, as a crash in the middle of a write leaves it; opening drops
+ *   it, and names added after that survive another reopen.
+ *
+ * Books live in a new directory under $TMPDIR (or /tmp), removed at the end.
+ *
+ * Usage: name_book_wal_test [rounds [seed]]
+ * \return 0 if every check passed; 1 otherwise
+ */
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include "name_book_wal.h"
+
+namespace {
+
+using NameCounts = std::map<std::string, size_t>;  //!< Reference book
+
+int g_failures = 0;  //!< Checks failed so far
+
+/**
+ * \brief Count and report a failed check
+ */
+void Check(bool ok, const char *what) {
+  if (!ok) {
+    ++g_failures;
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+}
+
+/**
+ * \brief Check if names in a count map are consistent: each added once, none
+ *        the beginning of another (sorted neighbours are enough)
+ */
+bool Consistent(const NameCounts &names) {
+  const std::string *prev = nullptr;
+  for (const auto &entry : names) {
+    if (entry.second > 1 ||
+        (prev != nullptr && entry.first.compare(0, prev->size(), *prev) == 0)) {
+      return false;
+    }
+    prev = &entry.first;
+  }
+
+  return true;
+}
+
+/**
+ * \brief Check a durable book has the names of the reference
+ */
+void CheckSame(const DurableNameBook &book, const NameCounts &names,
+               const char *what) {
+  NameCounts got;
+  book.book().ForEachName(
+      [&](std::string_view name) { ++got[std::string(name)]; });
+  Check(got == names, what);
+  Check(book.consistent() == Consistent(names), what);
+}
+
+/**
+ * \brief Draw a short name over a small alphabet (often empty, often a prefix
+ *        of another)
+ */
+std::string RandomName(std::mt19937_64 *rng) {
+  std::string name((*rng)() % 5, 'a');
+  for (char &c : name) {
+    c = static_cast<char>('a' + (*rng)() % 4);
+  }
+
+  return name;
+}
+
+/**
+ * \brief Get the newest log of a book directory
+ */
+std::string NewestLog(const std::string &dir) {
+  uint64_t newest = 0;
+  if (DIR *d = opendir(dir.c_str())) {
+    while (const dirent *e = readdir(d)) {
+      if (std::string_view(e->d_name).substr(0, 4) == "log.") {
+        newest = std::max<uint64_t>(newest,
+                                    std::strtoull(e->d_name + 4, nullptr, 10));
+      }
+    }
+    closedir(d);
+  }
+
+  return dir + "/log." + std::to_string(newest);
+}
+
+/**
+ * \brief Get size of a file (0 if missing)
+ */
+size_t FileSize(const std::string &file) {
+  struct stat st;
+  return stat(file.c_str(), &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+}
+
+/**
+ * \brief Random changes, compactions and reopens against the reference
+ */
+void TestRandom(const std::string &dir, uint32_t rounds, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  NameCounts names;
+
+  for (uint32_t round = 0; round < rounds; ++round) {
+    DurableNameBook book(dir, 1 + rng() % 64);
+    Check(book.Open() == WalRetCode::kOK, "random: open");
+    CheckSame(book, names, "random: names after reopen");
+
+    const size_t ops = rng() % 300;
+    for (size_t i = 0; i < ops; ++i) {
+      const std::string name = RandomName(&rng);
+      if (rng() % 3 != 0) {
+        book.AddName(name);
+        ++names[name];
+      } else {
+        const bool had = names.erase(name) > 0;
+        Check(book.RemoveName(name) == had, "random: remove");
+      }
+      if (rng() % 128 == 0) {
+        Check(book.Compact() == WalRetCode::kOK, "random: compact");
+      }
+    }
+    CheckSame(book, names, "random: names before close");
+
+    if (rng() % 2 == 0) {
+      Check(book.Compact() == WalRetCode::kOK, "random: compact");
+      Check(book.WaitCompaction() == WalRetCode::kOK, "random: compaction");
+    }
+    Check(book.Sync() == WalRetCode::kOK, "random: sync");
+    Check(book.status() == WalRetCode::kOK, "random: status");
+  }
+}
+
+/**
+ * \brief Torn last records are dropped, and the log goes on after them
+ */
+void TestTornTail(const std::string &dir) {
+  NameCounts names;
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open");
+    for (const char *name : {"ann", "bob", ""}) {
+      book.AddName(name);
+      ++names[name];
+    }
+    book.Compact();
+    Check(book.WaitCompaction() == WalRetCode::kOK, "torn: compaction");
+    book.AddName("cid");
+    ++names["cid"];
+    Check(book.Sync() == WalRetCode::kOK, "torn: sync");
+  }
+
+  // last record cut in the middle of its name
+  const std::string log = NewestLog(dir);
+  const size_t good = FileSize(log);
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open");
+    book.AddName("dorothy");
+    Check(book.Sync() == WalRetCode::kOK, "torn: sync");
+  }
+  const off_t cut = static_cast<off_t>(good + kWalHeaderSize + 3);
+  Check(truncate(log.c_str(), cut) == 0, "torn: truncate");
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open cut record");
+    CheckSame(book, names, "torn: cut record dropped");
+    book.AddName("eve");
+    ++names["eve"];
+  }
+
+  // garbage after the last whole record
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open");
+    CheckSame(book, names, "torn: names added after cut record");
+  }
+  if (FILE *f = std::fopen(log.c_str(), "ab")) {
+    std::fputs("\x07garbage", f);
+    std::fclose(f);
+  }
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open garbage");
+    CheckSame(book, names, "torn: garbage dropped");
+    book.RemoveName("ann");
+    names.erase("ann");
+  }
+  {
+    DurableNameBook book(dir);
+    Check(book.Open() == WalRetCode::kOK, "torn: open");
+    CheckSame(book, names, "torn: names removed after garbage");
+  }
+}
+
+/**
+ * \brief Make an empty directory for a book
+ * \return Directory; empty on error
+ */
+std::string MakeBookDir(const std::string &base, const char *name) {
+  const std::string dir = base + "/" + name;
+  return mkdir(dir.c_str(), 0755) == 0 ? dir : std::string();
+}
+
+/**
+ * \brief Remove a book directory and its files
+ */
+void RemoveBookDir(const std::string &dir) {
+  if (DIR *d = opendir(dir.c_str())) {
+    while (const dirent *e = readdir(d)) {
+      if (e->d_name[0] != '.') {
+        unlink((dir + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t rounds =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10)) : 40;
+  const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+  const char *tmp = std::getenv("TMPDIR");
+  std::string base = std::string(tmp != nullptr ? tmp : "/tmp") +
+                     "/name_book_wal_test.XXXXXX";
+  if (mkdtemp(&base[0]) == nullptr) {
+    std::cerr << "Cannot create directory " << base << std::endl;
+    return 1;
+  }
+
+  const std::string random_dir = MakeBookDir(base, "random");
+  const std::string torn_dir = MakeBookDir(base, "torn");
+  Check(!random_dir.empty() && !torn_dir.empty(), "book directories");
+  if (g_failures == 0) {
+    TestRandom(random_dir, rounds, seed);
+    TestTornTail(torn_dir);
+  }
+  RemoveBookDir(random_dir);
+  RemoveBookDir(torn_dir);
+  rmdir(base.c_str());
+
+  std::cout << (g_failures == 0 ? "ok" : "FAILED") << std::endl;
+
+  return g_failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,317 @@
+/**
+ * \brief Cellcrypt delimited name files
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Names from one column of a CSV or TSV file.
+ *
+ * The file is mapped, and names are views of the mapping: no copy, no stream.
+ * Fields are split at the delimiter and rows at '\n' (a '\r' before it is
+ * dropped). A field beginning with '"' is quoted: delimiters and new lines
+ * inside it are data, and "" is a '"' (only such fields are copied, to
+ * unescape them). Names keep their inner spaces, so multi-word names stay
+ * whole.
+ *
+ * Fields are short, so the file is not searched field by field: the
+ * dispatched char_masks3 kernel marks delimiters, new lines and quotes of 64
+ * bytes at a time, and the next one of any set is a bit scan on those masks.
+ * Past the column, only new lines and quotes opening a field are looked at.
+ */
+
+#ifndef NAME_CSV_H_
+#define NAME_CSV_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "cpu_dispatch.h"
+
+/**
+ * \brief CsvNameReader class
+ *
+ * Gives the field of a column of every row, like NameReader gives names;
+ * rows without that column, or with it empty, give none
+ */
+class CsvNameReader {
+ public:
+  /**
+   * \brief Constructor by file name and column
+   * \param file_name Delimited file
+   * \param column Column index (0 is the first)
+   * \param delim Field delimiter (',' for CSV, '\t' for TSV)
+   * \param header Skip the first row
+   */
+  CsvNameReader(const std::string &file_name, size_t column, char delim = ',',
+                bool header = false)
+      : data_(nullptr),
+        size_(0),
+        pos_(0),
+        open_(false),
+        column_(column),
+        chars_{delim, '\n', '"'},
+        block_(SIZE_MAX),
+        char_masks3_(cpu_kernels().char_masks3) {
+    const int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+      open_ = true;
+      size_ = static_cast<size_t>(st.st_size);
+    }
+    if (size_ > 0) {
+      void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        open_ = false;
+        size_ = 0;
+      } else {
+        madvise(map, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char *>(map);
+      }
+    }
+    close(fd);
+
+    if (header) {
+      SkipRow();
+    }
+  }
+
+  CsvNameReader(const CsvNameReader &) = delete;
+  CsvNameReader &operator=(const CsvNameReader &) = delete;
+
+  /**
+   * \brief Destructor
+   */
+  ~CsvNameReader() {
+    if (data_ != nullptr) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+  }
+
+  /**
+   * \brief Check if file could be opened
+   * \return true if open; false otherwise
+   */
+  bool is_open() const { return open_; }
+
+  /**
+   * \brief Check if the file could not be opened or mapped (a mapped file is
+   *        otherwise read whole)
+   * \return true if reading failed; false otherwise
+   */
+  bool failed() const { return !open_; }
+
+  /**
+   * \brief Get next name
+   * \param name Field of the column; valid while the reader lives, or until
+   *        next call for a quoted field with "" in it
+   * \return true if a name was read; false at end of file
+   */
+  bool Next(std::string_view *name) {
+    while (pos_ < size_) {
+      std::string_view found;
+      bool row_end = false;
+      for (size_t col = 0; !row_end && col <= column_; ++col) {
+        std::string_view field;
+        row_end = Field(col == column_, &field);
+        if (col == column_) {
+          found = field;
+        }
+      }
+      if (!row_end) {
+        SkipRest();
+      }
+      if (!found.empty()) {
+        *name = found;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+ private:
+  /**
+   * \brief Skip the rest of a row
+   */
+  void SkipRow() {
+    std::string_view field;
+    while (pos_ < size_ && !Field(false, &field)) {
+    }
+  }
+
+  /**
+   * \brief Skip the rest of a row from a field start, without splitting
+   *        fields: only a '"' right after a delimiter opens a quoted field
+   */
+  void SkipRest() {
+    bool field_start = true;
+    while (pos_ < size_) {
+      const size_t end = Find(pos_, kNewLine | kQuote);
+      if (end >= size_) {
+        pos_ = size_;
+        return;
+      }
+      if (data_[end] == '\n') {
+        pos_ = end + 1;
+        return;
+      }
+      if ((end == pos_ && field_start) || data_[end - 1] == chars_[0]) {
+        pos_ = end;
+        std::string_view field;
+        if (Field(false, &field)) {
+          return;
+        }
+        field_start = true;
+      } else {
+        pos_ = end + 1;
+        field_start = false;
+      }
+    }
+  }
+
+  /**
+   * \brief Read the field at pos_ and move past its delimiter
+   * \param want Field is wanted (unescape it if needed)
+   * \param field Field read
+   * \return true if it was the last of its row; false otherwise
+   */
+  bool Field(bool want, std::string_view *field) {
+    // delimiter at end of file: one more empty field
+    if (pos_ >= size_) {
+      *field = std::string_view();
+      return true;
+    }
+
+    size_t end = 0;
+    if (data_[pos_] == '"') {
+      // quoted: up to a '"' not doubled; an unclosed field takes the rest
+      const size_t begin = pos_ + 1;
+      size_t p = begin;
+      size_t quote = size_;
+      bool escaped = false;
+      for (;;) {
+        quote = Find(p, kQuote);
+        if (quote >= size_) {
+          p = size_;
+          break;
+        }
+        if (quote + 1 < size_ && data_[quote + 1] == '"') {
+          escaped = true;
+          p = quote + 2;
+          quote = size_;
+          continue;
+        }
+        p = quote + 1;
+        break;
+      }
+      *field = std::string_view(data_ + begin, quote - begin);
+      if (escaped && want) {
+        Unescape(field);
+      }
+      // chars between the closing quote and the delimiter are dropped
+      end = Find(p, kDelim | kNewLine);
+    } else {
+      end = Find(pos_, kDelim | kNewLine);
+      size_t len = end - pos_;
+      if (len > 0 && data_[end - 1] == '\r' &&
+          (end == size_ || data_[end] == '\n')) {
+        --len;
+      }
+      *field = std::string_view(data_ + pos_, len);
+    }
+
+    const bool row_end = end >= size_ || data_[end] == '\n';
+    pos_ = end < size_ ? end + 1 : size_;
+
+    return row_end;
+  }
+
+  /**
+   * \brief Find the next char of some sets
+   * \param pos First byte to look at
+   * \param sets Sets (kDelim, kNewLine, kQuote or'ed)
+   * \return Index of the char; size_ if none
+   */
+  size_t Find(size_t pos, uint32_t sets) {
+    while (pos < size_) {
+      const size_t block = pos / 64;
+      if (block != block_) {
+        LoadMasks(block);
+      }
+      uint64_t m = ((sets & kDelim) != 0 ? masks_[0] : 0) |
+                   ((sets & kNewLine) != 0 ? masks_[1] : 0) |
+                   ((sets & kQuote) != 0 ? masks_[2] : 0);
+      m &= ~uint64_t{0} << (pos % 64);
+      if (m != 0) {
+        return block * 64 + static_cast<size_t>(__builtin_ctzll(m));
+      }
+      pos = (block + 1) * 64;
+    }
+
+    return size_;
+  }
+
+  /**
+   * \brief Mark delimiters, new lines and quotes of a block of 64 bytes
+   */
+  void LoadMasks(size_t block) {
+    const size_t begin = block * 64;
+    if (begin + 64 <= size_) {
+      char_masks3_(data_ + begin, chars_, masks_);
+    } else {
+      // last block: the bytes past the end are no chars of the sets
+      char tail[64];
+      std::memset(tail, 0, sizeof(tail));
+      std::memcpy(tail, data_ + begin, size_ - begin);
+      char_masks3_(tail, chars_, masks_);
+      const uint64_t valid = (uint64_t{1} << (size_ - begin)) - 1;
+      for (uint64_t &m : masks_) {
+        m &= valid;
+      }
+    }
+    block_ = block;
+  }
+
+  /**
+   * \brief Replace "" by " in a field, into the scratch buffer
+   */
+  void Unescape(std::string_view *field) {
+    scratch_.clear();
+    for (size_t i = 0; i < field->size(); ++i) {
+      scratch_.push_back((*field)[i]);
+      if ((*field)[i] == '"') {
+        ++i;
+      }
+    }
+    *field = scratch_;
+  }
+
+  const char *data_;     //!< Mapped file; nullptr if empty or not open
+  size_t size_;          //!< File size
+  size_t pos_;           //!< Next byte to read
+  bool open_;            //!< File could be opened
+  static constexpr uint32_t kDelim = 1;    //!< Set of the delimiter
+  static constexpr uint32_t kNewLine = 2;  //!< Set of '\n'
+  static constexpr uint32_t kQuote = 4;    //!< Set of '"'
+
+  size_t column_;        //!< Column of names
+  char chars_[3];        //!< Delimiter, '\n' and '"'
+  size_t block_;         //!< Block of masks_; SIZE_MAX if none
+  uint64_t masks_[3];    //!< Bytes of block_ equal to each of chars_
+  void (*char_masks3_)(const char *, const char[3], uint64_t[3]);  //!< Kernel
+  std::string scratch_;  //!< Unescaped quoted field
+};
+
+#endif  // NAME_CSV_H_
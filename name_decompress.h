@@ -0,0 +1,385 @@
+/**
+ * \brief Cellcrypt compressed name files
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Streaming decompression of name files, for NameReader.
+ *
+ * Only built with -DCELLCRYPT_WITH_ZLIB (and -lz) for gzip and zlib files,
+ * and/or -DCELLCRYPT_WITH_ZSTD (and -lzstd) for zstd files; NameReader then
+ * takes compressed files by their first bytes, with no temporary file.
+ *
+ * A thread decompresses into two blocks in turn: while the reader scans names
+ * in one, the next one is being filled, so both run at once. Blocks are handed
+ * to the reader as they are, not copied.
+ *
+ * The file is read once from its start to its end, never reopened or seeked,
+ * so pipes and FIFOs (`<(zcat ...)`, /dev/stdin) work as well as files.
+ */
+
+#ifndef NAME_DECOMPRESS_H_
+#define NAME_DECOMPRESS_H_
+
+#if !defined(CELLCRYPT_WITH_ZLIB) && !defined(CELLCRYPT_WITH_ZSTD)
+#error "name_decompress.h needs -DCELLCRYPT_WITH_ZLIB and/or -DCELLCRYPT_WITH_ZSTD"
+#endif
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(CELLCRYPT_WITH_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+#include <zstd.h>
+#endif
+
+/**
+ * \brief Compressed file formats
+ */
+enum class Compression { kNone, kGzip, kZstd };
+
+/**
+ * \brief Tell the format of a file by its first bytes
+ * \param head First bytes of file
+ * \param len Number of bytes (fewer than 4: kNone)
+ * \return Format, kNone if not compressed or not built in
+ */
+inline Compression DetectCompression(const char *head, size_t len) {
+  const auto *b = reinterpret_cast<const unsigned char *>(head);
+#if defined(CELLCRYPT_WITH_ZLIB)
+  if (len >= 2 && b[0] == 0x1f && b[1] == 0x8b) {
+    return Compression::kGzip;
+  }
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+  if (len >= 4 && b[0] == 0x28 && b[1] == 0xb5 && b[2] == 0x2f &&
+      b[3] == 0xfd) {
+    return Compression::kZstd;
+  }
+#endif
+  static_cast<void>(b);
+  static_cast<void>(len);
+
+  return Compression::kNone;
+}
+
+/**
+ * \brief Decompresses a file on its own thread, block after block
+ */
+class Decompressor {
+ public:
+  static constexpr size_t kBlockSize = 1 << 20;  //!< Bytes of a block
+  static constexpr size_t kInSize = 1 << 16;     //!< Compressed bytes read
+
+  /**
+   * \brief Constructor by open file and format
+   * \param fd Compressed file, read from where it is (closed by destructor)
+   * \param format Format (not kNone)
+   * \param head Bytes already read from fd (the format was told by them)
+   * \param head_len Number of bytes (at most kInSize)
+   */
+  Decompressor(int fd, Compression format, const char *head, size_t head_len)
+      : format_(format),
+        fd_(fd),
+        in_(kInSize),
+        head_len_(std::min(head_len, kInSize)),
+        failed_(false),
+        done_(false),
+        stop_(false) {
+    std::memcpy(in_.data(), head, head_len_);
+    for (Block &b : blocks_) {
+      b.data.resize(kBlockSize);
+    }
+    if (fd_ < 0) {
+      done_ = true;
+      return;
+    }
+    thread_ = std::thread([this] { Run(); });
+  }
+
+  Decompressor(const Decompressor &) = delete;
+  Decompressor &operator=(const Decompressor &) = delete;
+
+  /**
+   * \brief Destructor: stops the thread, even with blocks unread
+   */
+  ~Decompressor() {
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  /**
+   * \brief Check if file is open
+   * \return true if open; false otherwise
+   */
+  bool is_open() const { return fd_ >= 0; }
+
+  /**
+   * \brief Check if data was corrupt or cut short, or could not be read
+   *        (after NextBlock() gave false)
+   * \return true if decompression failed; false otherwise
+   */
+  bool failed() const {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+  }
+
+  /**
+   * \brief Get the next block of decompressed bytes, waiting for it if not
+   *        filled yet; the block got before is handed back to be filled again
+   * \param data Out: bytes, valid until next call
+   * \param size Out: number of bytes (not 0)
+   * \return true if a block was got; false at end of data
+   */
+  bool NextBlock(const char **data, size_t *size) {
+    if (held_) {
+      {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        blocks_[read_block_].full = false;
+      }
+      cond_.notify_all();
+      read_block_ ^= 1;
+      held_ = false;
+    }
+
+    Block &b = blocks_[read_block_];
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [&] { return b.full || done_; });
+      if (!b.full) {
+        return false;
+      }
+    }
+
+    // a full block is the reader's until handed back
+    held_ = true;
+    *data = b.data.data();
+    *size = b.size;
+
+    return true;
+  }
+
+ private:
+  /**
+   * \brief Block of decompressed bytes
+   */
+  struct Block {
+    std::vector<char> data;  //!< Bytes
+    size_t size = 0;         //!< Bytes filled
+    bool full = false;       //!< Filled and not handed back yet
+  };
+
+  /**
+   * \brief Thread body: fill blocks in turn until end of data
+   */
+  void Run() {
+    bool ok = Init();
+    bool eof = !ok;
+    for (uint32_t w = 0; !eof; w ^= 1) {
+      Block &b = blocks_[w];
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [&] { return !b.full || stop_; });
+        if (stop_) {
+          break;
+        }
+      }
+      const size_t size = Decode(b.data.data(), kBlockSize, &eof, &ok);
+      {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        b.size = size;
+        b.full = size > 0;
+      }
+      cond_.notify_all();
+    }
+    End();
+
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      failed_ = !ok || read_error_;
+      done_ = true;
+    }
+    cond_.notify_all();
+  }
+
+  /**
+   * \brief Read more compressed bytes (once all before are decoded)
+   * \return Bytes read; 0 at end of file or error (read_error_ set)
+   */
+  size_t ReadIn() {
+    // bytes the format was told by come first
+    if (head_len_ > 0) {
+      const size_t got = head_len_;
+      head_len_ = 0;
+      return got;
+    }
+    for (;;) {
+      const ssize_t got = read(fd_, in_.data(), in_.size());
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      read_error_ = read_error_ || got < 0;
+      return got > 0 ? static_cast<size_t>(got) : 0;
+    }
+  }
+
+  /**
+   * \brief Set up the decoder of the format
+   * \return true on success; false otherwise
+   */
+  bool Init() {
+#if defined(CELLCRYPT_WITH_ZLIB)
+    if (format_ == Compression::kGzip) {
+      std::memset(&z_, 0, sizeof(z_));
+      // 15 + 32: any window, gzip or zlib header
+      return inflateInit2(&z_, 15 + 32) == Z_OK;
+    }
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+    if (format_ == Compression::kZstd) {
+      zstd_ = ZSTD_createDCtx();
+      return zstd_ != nullptr;
+    }
+#endif
+    return false;
+  }
+
+  /**
+   * \brief Free the decoder
+   */
+  void End() {
+#if defined(CELLCRYPT_WITH_ZLIB)
+    if (format_ == Compression::kGzip) {
+      inflateEnd(&z_);
+    }
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+    if (zstd_ != nullptr) {
+      ZSTD_freeDCtx(zstd_);
+      zstd_ = nullptr;
+    }
+#endif
+  }
+
+  /**
+   * \brief Decompress into a block until it is full or data ends
+   *
+   * Files of many members (cat a.gz b.gz, or many zstd frames) go on with
+   * the next member.
+   *
+   * \param out Block
+   * \param cap Block size
+   * \param eof Out: true once data ended
+   * \param ok Out: false if data was corrupt or cut inside a member
+   * \return Bytes written
+   */
+  size_t Decode(char *out, size_t cap, bool *eof, bool *ok) {
+#if defined(CELLCRYPT_WITH_ZLIB)
+    if (format_ == Compression::kGzip) {
+      z_.next_out = reinterpret_cast<Bytef *>(out);
+      z_.avail_out = static_cast<uInt>(cap);
+      while (z_.avail_out > 0) {
+        if (z_.avail_in == 0) {
+          const size_t got = ReadIn();
+          if (got == 0) {
+            *eof = true;
+            *ok = *ok && member_done_;
+            break;
+          }
+          z_.next_in = reinterpret_cast<Bytef *>(in_.data());
+          z_.avail_in = static_cast<uInt>(got);
+        }
+        member_done_ = false;
+        const int ret = inflate(&z_, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+          member_done_ = true;
+          inflateReset(&z_);
+        } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+          *eof = true;
+          *ok = false;
+          break;
+        }
+      }
+      return cap - z_.avail_out;
+    }
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+    if (format_ == Compression::kZstd) {
+      ZSTD_outBuffer o{out, cap, 0};
+      while (o.pos < o.size) {
+        if (zin_.pos == zin_.size) {
+          const size_t got = ReadIn();
+          if (got == 0) {
+            *eof = true;
+            *ok = *ok && member_done_;
+            break;
+          }
+          zin_ = ZSTD_inBuffer{in_.data(), got, 0};
+        }
+        const size_t ret = ZSTD_decompressStream(zstd_, &o, &zin_);
+        if (ZSTD_isError(ret)) {
+          *eof = true;
+          *ok = false;
+          break;
+        }
+        // 0: a frame just ended
+        member_done_ = ret == 0;
+      }
+      return o.pos;
+    }
+#endif
+    static_cast<void>(out);
+    static_cast<void>(cap);
+    *eof = true;
+    *ok = false;
+    return 0;
+  }
+
+  Compression format_;       //!< Format of file
+  int fd_;                   //!< Compressed file; -1 if not open
+  std::vector<char> in_;     //!< Compressed bytes
+  size_t head_len_;          //!< Bytes of in_ given at construction, not read
+  bool read_error_ = false;  //!< Reading the file failed
+  bool member_done_ = true;  //!< Decoder between members (a clean end)
+#if defined(CELLCRYPT_WITH_ZLIB)
+  z_stream z_;  //!< gzip decoder
+#endif
+#if defined(CELLCRYPT_WITH_ZSTD)
+  ZSTD_DCtx *zstd_ = nullptr;         //!< zstd decoder
+  ZSTD_inBuffer zin_{nullptr, 0, 0};  //!< Compressed bytes not decoded yet
+#endif
+
+  Block blocks_[2];               //!< Blocks filled in turn
+  uint32_t read_block_ = 0;       //!< Block being read, or next to read
+  bool held_ = false;             //!< Reader holds read_block_
+  mutable std::mutex mutex_;      //!< Guards full flags and states below
+  std::condition_variable cond_;  //!< Block filled or handed back
+  bool failed_;                   //!< Decompression failed
+  bool done_;                     //!< No block will be filled anymore
+  bool stop_;                     //!< Reader is gone
+  std::thread thread_;            //!< Decompression thread
+};
+
+#endif  // NAME_DECOMPRESS_H_
@@ -0,0 +1,196 @@
+/**
+ * \brief Cellcrypt name reader
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef NAME_READER_H_
+#define NAME_READER_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpu_dispatch.h"
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+#include "name_decompress.h"
+#endif
+
+/**
+ * \brief NameReader class
+ *
+ * Splits a file into white space separated names (same names as f >> name),
+ * reading it in blocks and scanning them with the dispatched kernels. Names
+ * are views of the block; only a name running from one block into the next
+ * is copied. The file is read once, in order, so it may be a pipe.
+ * Built with decompression (name_decompress.h), gzip and zstd files are read
+ * through a Decompressor, whose blocks are scanned as they are.
+ */
+class NameReader {
+ public:
+  static constexpr size_t kBlockSize = 1 << 16;  //!< Bytes read at a time
+
+  /**
+   * \brief Constructor by file name
+   * \param file_name File with names
+   */
+  explicit NameReader(const std::string &file_name)
+      : fd_(open(file_name.c_str(), O_RDONLY | O_CLOEXEC)),
+        read_failed_(false),
+        buf_(kBlockSize),
+        data_(buf_.data()),
+        begin_(0),
+        end_(0) {
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+    if (fd_ < 0) {
+      return;
+    }
+    // first bytes tell the format; plain text goes on from them, and the
+    // decoder is given them with the file: nothing is read twice
+    constexpr size_t kHeadSize = 4;
+    while (end_ < kHeadSize) {
+      const ssize_t got = read(fd_, buf_.data() + end_, kHeadSize - end_);
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got <= 0) {
+        read_failed_ = got < 0;
+        break;
+      }
+      end_ += static_cast<size_t>(got);
+    }
+    const Compression format = DetectCompression(buf_.data(), end_);
+    if (format != Compression::kNone) {
+      unzip_.reset(new Decompressor(fd_, format, buf_.data(), end_));
+      fd_ = -1;
+      end_ = 0;
+    }
+#endif
+  }
+
+  NameReader(const NameReader &) = delete;
+  NameReader &operator=(const NameReader &) = delete;
+
+  /**
+   * \brief Destructor
+   */
+  ~NameReader() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  /**
+   * \brief Check if file could be opened
+   * \return true if open; false otherwise
+   */
+  bool is_open() const {
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+    if (unzip_ != nullptr) {
+      return unzip_->is_open();
+    }
+#endif
+    return fd_ >= 0;
+  }
+
+  /**
+   * \brief Check if the file could not be opened or read whole (read error;
+   *        corrupt or cut compressed data); meaningful once Next() gave false
+   * \return true if reading failed; false otherwise
+   */
+  bool failed() const {
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+    if (unzip_ != nullptr) {
+      return unzip_->failed();
+    }
+#endif
+    return fd_ < 0 || read_failed_;
+  }
+
+  /**
+   * \brief Get next name
+   * \param name Name read; valid until next call
+   * \return true if a name was read; false at end of file
+   */
+  bool Next(std::string_view *name) {
+    const CpuKernels &k = cpu_kernels();
+
+    // skip white space, taking blocks while block is all white space
+    for (;;) {
+      begin_ += k.find_non_space(data_ + begin_, end_ - begin_);
+      if (begin_ < end_) {
+        break;
+      }
+      if (!NextBlock()) {
+        return false;
+      }
+    }
+
+    size_t len = k.find_space(data_ + begin_, end_ - begin_);
+    if (begin_ + len < end_) {
+      *name = std::string_view(data_ + begin_, len);
+      begin_ += len;
+      return true;
+    }
+
+    // name goes on in the next blocks: only it is copied
+    carry_.assign(data_ + begin_, len);
+    while (NextBlock()) {
+      len = k.find_space(data_, end_);
+      carry_.append(data_, len);
+      begin_ = len;
+      if (len < end_) {
+        break;
+      }
+    }
+    *name = carry_;
+
+    return true;
+  }
+
+ private:
+  /**
+   * \brief Move on to the next block of the file
+   * \return true if it has bytes; false at end of file
+   */
+  bool NextBlock() {
+    begin_ = end_ = 0;
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+    if (unzip_ != nullptr) {
+      return unzip_->NextBlock(&data_, &end_);
+    }
+#endif
+    if (fd_ < 0) {
+      return false;
+    }
+    data_ = buf_.data();
+    for (;;) {
+      const ssize_t got = read(fd_, buf_.data(), kBlockSize);
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      read_failed_ = read_failed_ || got < 0;
+      end_ = got > 0 ? static_cast<size_t>(got) : 0;
+      return end_ > 0;
+    }
+  }
+
+  int fd_;                 //!< File read; -1 if not open or given away
+  bool read_failed_;       //!< Reading fd_ failed
+#if defined(CELLCRYPT_WITH_ZLIB) || defined(CELLCRYPT_WITH_ZSTD)
+  std::unique_ptr<Decompressor> unzip_;  //!< Compressed file; null if plain
+#endif
+  std::vector<char> buf_;  //!< Block read from fd_
+  const char *data_;       //!< Block being scanned (buf_ or a Decompressor's)
+  size_t begin_;           //!< First unread byte of block
+  size_t end_;             //!< End of block
+  std::string carry_;      //!< Name running over blocks
+};
+
+#endif  // NAME_READER_H_
@@ -0,0 +1,258 @@
+/**
+ * \brief Cellcrypt name file tail
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Follows a name file that other programs keep appending to.
+ *
+ * The file is opened once and read from where the last read stopped when
+ * inotify says it changed, so every name is read once however long the file
+ * gets. A name is handed over once white space after it is seen (a writer may
+ * be in the middle of it).
+ *
+ * - truncation (size below the read offset, as copytruncate does), or a
+ *   rewrite past it (the last bytes read are not there anymore): reading
+ *   starts again from the beginning;
+ * - rotation (file renamed or removed, a new one created under the name): the
+ *   old file is read to its end, its last name handed over, and the new file
+ *   is followed from its beginning. The directory is watched for the name.
+ */
+
+#ifndef NAME_TAIL_H_
+#define NAME_TAIL_H_
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cpu_dispatch.h"
+
+/**
+ * \brief NameTail class
+ *
+ * Calls a function on every name appended to a file (same names as
+ * NameReader), as soon as it is written
+ */
+class NameTail {
+ public:
+  static constexpr size_t kBlockSize = 1 << 16;  //!< Bytes read at a time
+  static constexpr size_t kCheckSize = 16;       //!< Bytes kept to see rewrite
+
+  /**
+   * \brief Constructor by file name (the file need not exist yet)
+   * \param file_name File with names
+   */
+  explicit NameTail(const std::string &file_name)
+      : path_(file_name),
+        inotify_(inotify_init1(IN_CLOEXEC)),
+        dir_watch_(-1),
+        file_watch_(-1),
+        fd_(-1),
+        ino_(0),
+        offset_(0),
+        buf_(kBlockSize),
+        end_(0) {
+    const size_t slash = path_.rfind('/');
+    const std::string dir =
+        slash == std::string::npos ? "." : path_.substr(0, slash + 1);
+    base_ = slash == std::string::npos ? path_ : path_.substr(slash + 1);
+    if (inotify_ >= 0) {
+      dir_watch_ = inotify_add_watch(inotify_, dir.c_str(),
+                                     IN_CREATE | IN_MOVED_TO);
+    }
+    Reopen();
+  }
+
+  NameTail(const NameTail &) = delete;
+  NameTail &operator=(const NameTail &) = delete;
+
+  /**
+   * \brief Destructor
+   */
+  ~NameTail() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    if (inotify_ >= 0) {
+      close(inotify_);
+    }
+  }
+
+  /**
+   * \brief Check if changes can be watched
+   * \return true if inotify and the directory watch are set; false otherwise
+   */
+  bool is_open() const { return inotify_ >= 0 && dir_watch_ >= 0; }
+
+  /**
+   * \brief Hand over names written so far, then wait for changes
+   *
+   * Names already in the file go on the first call.
+   *
+   * \param timeout_ms Longest wait for a change in ms (-1: no limit)
+   * \param fn Function of a std::string_view (valid during the call)
+   * \return true on success; false on error
+   */
+  template <typename Fn>
+  bool Poll(int timeout_ms, Fn &&fn) {
+    ReadNew(fn);
+
+    pollfd p{inotify_, POLLIN, 0};
+    const int ready = poll(&p, 1, timeout_ms);
+    if (ready < 0) {
+      return errno == EINTR;
+    }
+    if (ready == 0) {
+      return true;
+    }
+
+    // events only say something changed: offsets and inodes say what
+    alignas(inotify_event) char events[4096];
+    bool rotated = false;
+    const ssize_t got = read(inotify_, events, sizeof(events));
+    for (ssize_t i = 0; i < got;) {
+      const inotify_event *e = reinterpret_cast<inotify_event *>(events + i);
+      if (e->wd == file_watch_ && (e->mask & (IN_MOVE_SELF | IN_DELETE_SELF))) {
+        rotated = true;
+      }
+      if (e->wd == dir_watch_ && e->len > 0 && base_ == e->name) {
+        rotated = true;
+      }
+      i += static_cast<ssize_t>(sizeof(inotify_event) + e->len);
+    }
+
+    ReadNew(fn);
+    if (rotated && Reopen()) {
+      // old file is done: its unended last name is whole
+      if (end_ > 0) {
+        fn(std::string_view(buf_.data(), end_));
+        end_ = 0;
+      }
+      ReadNew(fn);
+    }
+
+    return true;
+  }
+
+ private:
+  /**
+   * \brief Follow the file now under the name, if it is another one
+   * \return true if another file is followed; false otherwise
+   */
+  bool Reopen() {
+    struct stat st;
+    if (stat(path_.c_str(), &st) != 0 || (fd_ >= 0 && st.st_ino == ino_)) {
+      return false;
+    }
+    const int fd = open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return false;
+    }
+    if (fd_ >= 0) {
+      close(fd_);
+      inotify_rm_watch(inotify_, file_watch_);
+    }
+    fd_ = fd;
+    ino_ = st.st_ino;
+    offset_ = 0;
+    last_.clear();
+    file_watch_ = inotify_add_watch(inotify_, path_.c_str(),
+                                    IN_MODIFY | IN_MOVE_SELF | IN_DELETE_SELF);
+
+    return true;
+  }
+
+  /**
+   * \brief Read bytes appended since the last read, handing over whole names
+   */
+  template <typename Fn>
+  void ReadNew(Fn &fn) {
+    if (fd_ < 0) {
+      return;
+    }
+    struct stat st;
+    if ((fstat(fd_, &st) == 0 && static_cast<size_t>(st.st_size) < offset_) ||
+        !LastUnchanged()) {
+      offset_ = 0;
+      end_ = 0;
+      last_.clear();
+    }
+
+    const CpuKernels &k = cpu_kernels();
+    for (;;) {
+      if (buf_.size() - end_ < kBlockSize) {
+        buf_.resize(end_ + kBlockSize);
+      }
+      const ssize_t got = pread(fd_, buf_.data() + end_, kBlockSize,
+                                static_cast<off_t>(offset_));
+      if (got < 0 && errno == EINTR) {
+        continue;
+      }
+      if (got <= 0) {
+        return;
+      }
+      offset_ += static_cast<size_t>(got);
+      last_.append(buf_.data() + end_, static_cast<size_t>(got));
+      if (last_.size() > kCheckSize) {
+        last_.erase(0, last_.size() - kCheckSize);
+      }
+      end_ += static_cast<size_t>(got);
+
+      // names ended by white space; the rest waits for more bytes
+      size_t begin = 0;
+      for (;;) {
+        begin += k.find_non_space(buf_.data() + begin, end_ - begin);
+        const size_t len = k.find_space(buf_.data() + begin, end_ - begin);
+        if (begin + len == end_) {
+          break;
+        }
+        fn(std::string_view(buf_.data() + begin, len));
+        begin += len;
+      }
+      std::memmove(buf_.data(), buf_.data() + begin, end_ - begin);
+      end_ -= begin;
+    }
+  }
+
+  /**
+   * \brief Check if the last bytes read are still in the file where they were
+   *        (a file cut and written again past offset_ is not)
+   * \return true if they are, or none were read; false otherwise
+   */
+  bool LastUnchanged() const {
+    if (last_.empty()) {
+      return true;
+    }
+    char now[kCheckSize];
+    const ssize_t got = pread(fd_, now, last_.size(),
+                              static_cast<off_t>(offset_ - last_.size()));
+
+    return got == static_cast<ssize_t>(last_.size()) &&
+           std::memcmp(now, last_.data(), last_.size()) == 0;
+  }
+
+  std::string path_;       //!< File name followed
+  std::string base_;       //!< File name without directory
+  int inotify_;            //!< inotify descriptor
+  int dir_watch_;          //!< Watch of the directory
+  int file_watch_;         //!< Watch of the file followed
+  int fd_;                 //!< File followed; -1 if none yet
+  ino_t ino_;              //!< Inode of fd_
+  size_t offset_;          //!< Next byte of fd_ to read
+  std::string last_;       //!< Last bytes read, up to offset_
+  std::vector<char> buf_;  //!< Unended name, then bytes read
+  size_t end_;             //!< End of bytes in buf_
+};
+
+#endif  // NAME_TAIL_H_
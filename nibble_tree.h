@@ -0,0 +1,194 @@
+/**
+ * \brief Cellcrypt nibble word tree
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Word tree of any bytes (UTF-8 or binary names) with small nodes.
+ *
+ * A byte alphabet in WordTree takes 256 children per node (2 KiB). Here each
+ * byte is two steps of 4 bits, high nibble first, so a node has 16 children.
+ * Children are 32 bit indices into a node pool rather than pointers, which
+ * makes a node 64 bytes: one cache line.
+ *
+ * Words end only at byte boundaries; end of word flags live apart from nodes
+ * to keep them at one line.
+ */
+
+#ifndef NIBBLE_TREE_H_
+#define NIBBLE_TREE_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+#include "word_tree.h"
+
+/**
+ * \brief NibbleTree class
+ *
+ * Same AddWord() rule and return codes as WordTree, for any bytes: every char
+ * is valid, so kInvalidChar is never returned.
+ */
+class NibbleTree {
+ public:
+  using Letters = AlphabetByte;  //!< Alphabet of words (any byte)
+
+  /**
+   * \brief Default constructor
+   */
+  NibbleTree() : nodes_(1), terminal_(1, false) {}
+
+  /**
+   * \brief Add word to tree
+   *
+   * A collision is reported when the word begins with a word already in the
+   * tree, or a word already in the tree begins with it.
+   *
+   * \param word Word (any bytes)
+   * \return TreeRetCode
+   */
+  TreeRetCode AddWord(std::string_view word) {
+    TreeRetCode ret = TreeRetCode::kOK;
+
+    uint32_t node = kRoot;
+    for (const char c : word) {
+      // passing by the end of another word is a collision
+      if (terminal_[node]) {
+        ret = TreeRetCode::KCollision;
+      }
+
+      const uint8_t byte = static_cast<uint8_t>(c);
+      node = AddNode(node, byte >> 4);
+      node = AddNode(node, byte & 0xf);
+    }
+
+    // same word again, or word is the beginning of another one
+    if (terminal_[node] || HasChildren(node)) {
+      ret = TreeRetCode::KCollision;
+    }
+    terminal_[node] = true;
+
+    return ret;
+  }
+
+  /**
+   * \brief Replace the tree by the given words, in one pass
+   *
+   * Words are taken in sorted order, so each one only adds the nodes past the
+   * nibbles it shares with the previous word, in pool order.
+   *
+   * \param words Sorted words (std::string_view convertible)
+   * \return KCollision if any word begins another (same word included);
+   *         otherwise kOK
+   */
+  template <typename Range>
+  TreeRetCode BuildFromSorted(const Range &words) {
+    Clear();
+    auto any = [](std::string_view) { return true; };
+
+    // nibbles shared with the previous word: a differing byte may still
+    // share its high nibble
+    std::string_view prev;
+    auto shared = [&](std::string_view word, size_t common) {
+      size_t nibbles = 2 * common;
+      if (common < word.size() && common < prev.size() &&
+          (static_cast<uint8_t>(word[common]) >> 4) ==
+              (static_cast<uint8_t>(prev[common]) >> 4)) {
+        ++nibbles;
+      }
+      prev = word;
+      return nibbles;
+    };
+
+    size_t num_nodes = 1;
+    size_t max_length = 0;
+    ForEachSortedWord(words, any, [&](std::string_view word, size_t common) {
+      num_nodes += 2 * word.size() - shared(word, common);
+      max_length = std::max(max_length, word.size());
+    });
+    assert(num_nodes <= std::numeric_limits<uint32_t>::max());
+    nodes_.reserve(num_nodes);
+    terminal_.reserve(num_nodes);
+
+    // path[d]: node of the previous word at nibble depth d
+    std::vector<uint32_t> path(2 * max_length + 1, kRoot);
+    prev = std::string_view();
+
+    return ForEachSortedWord(
+        words, any, [&](std::string_view word, size_t common) {
+          for (size_t d = shared(word, common); d < 2 * word.size(); ++d) {
+            const uint8_t byte = static_cast<uint8_t>(word[d / 2]);
+            path[d + 1] = AddNode(path[d], d % 2 == 0 ? byte >> 4 : byte & 0xf);
+          }
+          terminal_[path[2 * word.size()]] = true;
+        });
+  }
+
+  /**
+   * \brief Remove all words from tree
+   */
+  void Clear() {
+    nodes_.assign(1, NibbleNode());
+    terminal_.assign(1, false);
+  }
+
+  /**
+   * \brief Get the number of nodes (root included)
+   * \return Number of nodes
+   */
+  size_t num_nodes() const { return nodes_.size(); }
+
+ private:
+  static constexpr uint32_t kRoot = 0;     //!< Root index; as child, none
+  static constexpr uint32_t kFanOut = 16;  //!< Children per node (a nibble)
+
+  /**
+   * \brief Node of 16 children, one cache line
+   */
+  struct alignas(64) NibbleNode {
+    uint32_t children[kFanOut] = {};  //!< Child indices; kRoot if none
+  };
+  static_assert(sizeof(NibbleNode) == 64, "nibble node is one cache line");
+
+  /**
+   * \brief Get a child, adding it if missing
+   * \param node Parent index
+   * \param nibble Child nibble
+   * \return Child index
+   */
+  uint32_t AddNode(uint32_t node, uint32_t nibble) {
+    uint32_t child = nodes_[node].children[nibble];
+    if (child == kRoot) {
+      assert(nodes_.size() < std::numeric_limits<uint32_t>::max());
+      child = static_cast<uint32_t>(nodes_.size());
+      nodes_.emplace_back();  // may move nodes: index again below
+      terminal_.push_back(false);
+      nodes_[node].children[nibble] = child;
+    }
+
+    return child;
+  }
+
+  /**
+   * \brief Check if a node has any child
+   */
+  bool HasChildren(uint32_t node) const {
+    const uint32_t *c = nodes_[node].children;
+    uint32_t any = 0;
+    for (uint32_t i = 0; i < kFanOut; ++i) {
+      any |= c[i];
+    }
+
+    return any != 0;
+  }
+
+  std::vector<NibbleNode> nodes_;  //!< Node pool; nodes_[kRoot] is the root
+  std::vector<bool> terminal_;     //!< Flag per node: a word ends here
+};
+
+#endif  // NIBBLE_TREE_H_
@@ -0,0 +1,218 @@
+/**
+ * \brief Cellcrypt text scanning kernels
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef TEXT_KERNELS_H_
+#define TEXT_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+/**
+ * \brief Check if char is white space (same set as std::isspace in "C" locale)
+ * \return true if white space; false otherwise
+ */
+inline bool IsSpaceChar(char c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+/**
+ * \brief Find first white space char
+ * \return Index of first white space; n if none
+ */
+inline size_t FindSpaceScalar(const char *p, size_t n) {
+  size_t i = 0;
+  while (i < n && !IsSpaceChar(p[i])) {
+    ++i;
+  }
+
+  return i;
+}
+
+/**
+ * \brief Find first char that is not white space
+ * \return Index of first char that is not white space; n if none
+ */
+inline size_t FindNonSpaceScalar(const char *p, size_t n) {
+  size_t i = 0;
+  while (i < n && IsSpaceChar(p[i])) {
+    ++i;
+  }
+
+  return i;
+}
+
+/**
+ * \brief Get length of common prefix of two strings of n chars
+ * \return Index of first different char; n if equal
+ */
+inline size_t CommonPrefixScalar(const char *a, const char *b, size_t n) {
+  size_t i = 0;
+  while (i < n && a[i] == b[i]) {
+    ++i;
+  }
+
+  return i;
+}
+
+/**
+ * \brief Masks of the bytes equal to each of three chars in 64 bytes
+ * \param p 64 bytes
+ * \param c Chars
+ * \param masks Out: bit i of masks[j] set if p[i] == c[j]
+ */
+inline void CharMasks3Scalar(const char *p, const char c[3],
+                             uint64_t masks[3]) {
+  masks[0] = masks[1] = masks[2] = 0;
+  for (uint32_t i = 0; i < 64; ++i) {
+    masks[0] |= static_cast<uint64_t>(p[i] == c[0]) << i;
+    masks[1] |= static_cast<uint64_t>(p[i] == c[1]) << i;
+    masks[2] |= static_cast<uint64_t>(p[i] == c[2]) << i;
+  }
+}
+
+#if defined(__x86_64__)
+
+/**
+ * \brief Mask of white space bytes in 32 bytes
+ */
+__attribute__((target("avx2"))) inline uint32_t SpaceMaskAvx2(const char *p) {
+  const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  const __m256i v9 = _mm256_sub_epi8(v, _mm256_set1_epi8('\t'));
+  // '\t' to '\r' -> v - '\t' <= 4 (unsigned)
+  const __m256i ctrl =
+      _mm256_cmpeq_epi8(_mm256_min_epu8(v9, _mm256_set1_epi8(4)), v9);
+  const __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+  return static_cast<uint32_t>(
+      _mm256_movemask_epi8(_mm256_or_si256(ctrl, space)));
+}
+
+__attribute__((target("avx2"))) inline size_t FindSpaceAvx2(const char *p,
+                                                            size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const uint32_t mask = SpaceMaskAvx2(p + i);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + FindSpaceScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline size_t FindNonSpaceAvx2(const char *p,
+                                                               size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const uint32_t mask = ~SpaceMaskAvx2(p + i);
+    if (mask) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+
+  return i + FindNonSpaceScalar(p + i, n - i);
+}
+
+__attribute__((target("avx2"))) inline void CharMasks3Avx2(const char *p,
+                                                           const char c[3],
+                                                           uint64_t masks[3]) {
+  const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  const __m256i hi =
+      _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+  for (int j = 0; j < 3; ++j) {
+    const __m256i v = _mm256_set1_epi8(c[j]);
+    masks[j] = static_cast<uint32_t>(
+                   _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, v))) |
+               static_cast<uint64_t>(static_cast<uint32_t>(
+                   _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, v))))
+                   << 32;
+  }
+}
+
+__attribute__((target("avx2"))) inline size_t CommonPrefixAvx2(const char *a,
+                                                               const char *b,
+                                                               size_t n) {
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const __m256i va =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+    const __m256i vb =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+    const uint32_t diff =
+        ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+    if (diff) {
+      return i + __builtin_ctz(diff);
+    }
+  }
+
+  return i + CommonPrefixScalar(a + i, b + i, n - i);
+}
+
+/**
+ * \brief Mask of white space bytes in 64 bytes
+ */
+__attribute__((target("avx512f,avx512bw"))) inline uint64_t SpaceMaskAvx512(
+    const char *p) {
+  const __m512i v = _mm512_loadu_si512(p);
+  const __m512i v9 = _mm512_sub_epi8(v, _mm512_set1_epi8('\t'));
+  return _mm512_cmple_epu8_mask(v9, _mm512_set1_epi8(4)) |
+         _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(' '));
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline size_t FindSpaceAvx512(
+    const char *p, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const uint64_t mask = SpaceMaskAvx512(p + i);
+    if (mask) {
+      return i + __builtin_ctzll(mask);
+    }
+  }
+
+  return i + FindSpaceScalar(p + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline size_t FindNonSpaceAvx512(
+    const char *p, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const uint64_t mask = ~SpaceMaskAvx512(p + i);
+    if (mask) {
+      return i + __builtin_ctzll(mask);
+    }
+  }
+
+  return i + FindNonSpaceScalar(p + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline void CharMasks3Avx512(
+    const char *p, const char c[3], uint64_t masks[3]) {
+  const __m512i v = _mm512_loadu_si512(p);
+  for (int j = 0; j < 3; ++j) {
+    masks[j] = _mm512_cmpeq_epi8_mask(v, _mm512_set1_epi8(c[j]));
+  }
+}
+
+__attribute__((target("avx512f,avx512bw"))) inline size_t CommonPrefixAvx512(
+    const char *a, const char *b, size_t n) {
+  size_t i = 0;
+  for (; i + 64 <= n; i += 64) {
+    const uint64_t diff = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + i),
+                                                  _mm512_loadu_si512(b + i));
+    if (diff) {
+      return i + __builtin_ctzll(diff);
+    }
+  }
+
+  return i + CommonPrefixScalar(a + i, b + i, n - i);
+}
+
+#endif  // defined(__x86_64__)
+
+#endif  // TEXT_KERNELS_H_
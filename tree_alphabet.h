@@ -0,0 +1,192 @@
+/**
+ * \brief Cellcrypt word tree alphabets
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Alphabet policies of BasicWordTree (word_tree.h).
+ *
+ * An alphabet has kSize letters (the fan-out of a node) and a constexpr table
+ * kIndex from every byte to its letter index, or kNotInAlphabet. Nodes size
+ * their children array by kSize, so each deployment gets the smallest node
+ * that holds its names, and a char is mapped by one table load.
+ *
+ * - AlphabetLower: a to z (the original name book rule);
+ * - AlphabetAlnumFold: letters with case folded (A and a are the same letter)
+ *   and digits;
+ * - AlphabetByte: any byte, UTF-8 and binary names included;
+ * - AlphabetSet<'x', 'y', ...>: the given chars, in that order.
+ *
+ * Trees built from sorted words (BuildFromSorted()) take them in letter
+ * order, SortWords<Alphabet>(): words are compared on letter indices, so
+ * chars of one letter ('A' and 'a' when folded) are the same there too. Most
+ * alphabets keep byte order (kAlphabetByteOrder), and then it is plain byte
+ * order.
+ */
+
+#ifndef TREE_ALPHABET_H_
+#define TREE_ALPHABET_H_
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+//! Index of bytes out of an alphabet
+constexpr uint16_t kNotInAlphabet = 0xffff;
+
+//! Letter index of every byte
+using AlphabetIndex = std::array<uint16_t, 256>;
+
+/**
+ * \brief Build a letter index table
+ * \param fn Function of a byte giving its index (or kNotInAlphabet)
+ * \return Table
+ */
+template <typename Fn>
+constexpr AlphabetIndex MakeAlphabetIndex(Fn fn) {
+  AlphabetIndex index{};
+  for (uint32_t c = 0; c < index.size(); ++c) {
+    index[c] = fn(static_cast<unsigned char>(c));
+  }
+
+  return index;
+}
+
+/**
+ * \brief Lowercase letters a to z
+ */
+struct AlphabetLower {
+  static constexpr uint32_t kSize = 26;  //!< Number of letters
+  static constexpr AlphabetIndex kIndex =
+      MakeAlphabetIndex([](unsigned char c) -> uint16_t {
+        return c >= 'a' && c <= 'z' ? c - 'a' : kNotInAlphabet;
+      });  //!< Letter index of every byte
+};
+
+/**
+ * \brief Letters (case folded) and digits
+ */
+struct AlphabetAlnumFold {
+  static constexpr uint32_t kSize = 36;  //!< Number of letters
+  static constexpr AlphabetIndex kIndex =
+      MakeAlphabetIndex([](unsigned char c) -> uint16_t {
+        if (c >= 'a' && c <= 'z') {
+          return c - 'a';
+        }
+        if (c >= 'A' && c <= 'Z') {
+          return c - 'A';
+        }
+        return c >= '0' && c <= '9' ? 26 + c - '0' : kNotInAlphabet;
+      });  //!< Letter index of every byte
+};
+
+/**
+ * \brief Every byte value
+ */
+struct AlphabetByte {
+  static constexpr uint32_t kSize = 256;  //!< Number of letters
+  static constexpr AlphabetIndex kIndex = MakeAlphabetIndex(
+      [](unsigned char c) -> uint16_t { return c; });  //!< Byte itself
+};
+
+/**
+ * \brief Custom set of chars
+ *
+ * Chars must be distinct; their order gives the letter index.
+ */
+template <char... Chars>
+struct AlphabetSet {
+  static_assert(sizeof...(Chars) > 0 && sizeof...(Chars) <= 256,
+                "alphabet needs 1 to 256 chars");
+
+  static constexpr uint32_t kSize = sizeof...(Chars);  //!< Number of letters
+  static constexpr AlphabetIndex kIndex =
+      MakeAlphabetIndex([](unsigned char c) -> uint16_t {
+        constexpr char kChars[] = {Chars...};
+        for (uint16_t i = 0; i < kSize; ++i) {
+          if (static_cast<unsigned char>(kChars[i]) == c) {
+            return i;
+          }
+        }
+        return kNotInAlphabet;
+      });  //!< Letter index of every byte
+};
+
+/**
+ * \brief Check if letter order is byte order: each letter is one byte, and
+ *        greater bytes are greater letters
+ */
+template <typename Alphabet>
+constexpr bool AlphabetKeepsByteOrder() {
+  uint32_t last = 0;
+  bool any = false;
+  for (uint32_t c = 0; c < Alphabet::kIndex.size(); ++c) {
+    const uint16_t index = Alphabet::kIndex[c];
+    if (index == kNotInAlphabet) {
+      continue;
+    }
+    if (any && index <= last) {
+      return false;
+    }
+    last = index;
+    any = true;
+  }
+
+  return true;
+}
+
+//! Words of the alphabet sort and compare as plain bytes
+template <typename Alphabet>
+inline constexpr bool kAlphabetByteOrder = AlphabetKeepsByteOrder<Alphabet>();
+
+/**
+ * \brief Less than on letter indices (chars out of the alphabet last)
+ */
+template <typename Alphabet>
+struct AlphabetLess {
+  bool operator()(std::string_view a, std::string_view b) const {
+    if constexpr (kAlphabetByteOrder<Alphabet>) {
+      return a < b;
+    } else {
+      const size_t n = std::min(a.size(), b.size());
+      for (size_t i = 0; i < n; ++i) {
+        const uint16_t x = Alphabet::kIndex[static_cast<unsigned char>(a[i])];
+        const uint16_t y = Alphabet::kIndex[static_cast<unsigned char>(b[i])];
+        if (x != y) {
+          return x < y;
+        }
+      }
+      return a.size() < b.size();
+    }
+  }
+};
+
+/**
+ * \brief Number of leading letters two words share (chars of the same letter
+ *        are the same)
+ */
+template <typename Alphabet>
+inline size_t AlphabetCommonPrefix(std::string_view a, std::string_view b) {
+  const size_t n = std::min(a.size(), b.size());
+  size_t i = 0;
+  while (i < n && Alphabet::kIndex[static_cast<unsigned char>(a[i])] ==
+                      Alphabet::kIndex[static_cast<unsigned char>(b[i])]) {
+    ++i;
+  }
+
+  return i;
+}
+
+/**
+ * \brief Sort words in letter order, as BuildFromSorted() takes them
+ */
+template <typename Alphabet>
+inline void SortWords(std::vector<std::string_view> *words) {
+  std::sort(words->begin(), words->end(), AlphabetLess<Alphabet>());
+}
+
+#endif  // TREE_ALPHABET_H_
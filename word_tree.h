@@ -0,0 +1,695 @@
+/**
+ * \brief Cellcrypt word tree
+ *
+ * Copyright Felipe Bolsi
+ */
+
+#ifndef WORD_TREE_H_
+#define WORD_TREE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "cpu_dispatch.h"
+#include "tree_alphabet.h"
+
+/**
+ * \brief Node class
+ *
+ * Node stores its data and all its possible children, one per letter of the
+ * Alphabet (see tree_alphabet.h)
+ */
+template <typename Alphabet>
+class BasicNode {
+ public:
+  /**
+   * \brief Constructor by data
+   */
+  explicit BasicNode(char c)
+      : num_children_(0), data_(c), in_arena_(false), words_(0) {
+    for (uint32_t i = 0; i < kMaxChildren; ++i) {
+      children_[i] = nullptr;
+    }
+  }
+
+  BasicNode(const BasicNode &) = delete;
+  BasicNode &operator=(const BasicNode &) = delete;
+
+  /**
+   * \bfief Destructor
+   */
+  ~BasicNode() { Clear(); }
+
+  /**
+   * \brief Find child node based on data
+   * \param c Data
+   * \return true if child found; false otherwise
+   */
+  bool FindChild(char c) const {
+    return children_[IndexFromChar(c)] != nullptr;
+  }
+
+  /**
+   * \brief Get child node based on data
+   * \param c Data
+   * \return Child node
+   */
+  BasicNode *GetChild(char c) const { return children_[IndexFromChar(c)]; }
+
+  /**
+   * \brief Get child node by letter index
+   * \param i Letter index (less than the alphabet size)
+   * \return Child node; nullptr if none
+   */
+  BasicNode *child(uint32_t i) const { return children_[i]; }
+
+  /**
+   * \brief Detach a child node, handing it to the caller
+   * \param i Letter index of the child (must be there)
+   * \return Child node
+   */
+  BasicNode *ReleaseChild(uint32_t i) {
+    BasicNode *node = children_[i];
+    assert(node != nullptr);
+    children_[i] = nullptr;
+    --num_children_;
+
+    return node;
+  }
+
+  /**
+   * \brief Add a child node to this node (it does not check collision!)
+   * \brief node Child node
+   */
+  void AddChild(BasicNode *node) {
+    const uint32_t index = IndexFromChar(node->data_);
+    children_[index] = node;
+    ++num_children_;
+  }
+
+  /**
+   * \brief Delete all children and unmark node as end of word
+   *
+   * Children in an arena are only cleared; the arena owner frees them.
+   */
+  void Clear() {
+    for (uint32_t i = 0; i < kMaxChildren; ++i) {
+      if (children_[i] != nullptr) {
+        if (children_[i]->in_arena_) {
+          children_[i]->Clear();
+        } else {
+          delete children_[i];
+        }
+        children_[i] = nullptr;
+      }
+    }
+    num_children_ = 0;
+    words_ = 0;
+  }
+
+  /**
+   * \brief Get the number of children of the node
+   * \return Number of children
+   */
+  uint16_t num_children() const { return num_children_; }
+
+  /**
+   * \brief Get data char of the node
+   */
+  char data() const { return data_; }
+
+  /**
+   * \brief Check if a word ends at this node
+   * \return true if node is end of word; false otherwise
+   */
+  bool terminal() const { return words_ != 0; }
+
+  /**
+   * \brief Mark node as end of one more word
+   */
+  void set_terminal() { ++words_; }
+
+  /**
+   * \brief Unmark node as end of word (all words ending here)
+   */
+  void unset_terminal() { words_ = 0; }
+
+  /**
+   * \brief Get the number of words ending at this node (same word added more
+   *        than once)
+   */
+  uint32_t words() const { return words_; }
+
+  /**
+   * \brief Mark node as end of more words
+   * \param n Number of words
+   */
+  void add_words(uint32_t n) { words_ += n; }
+
+  /**
+   * \brief Mark node as placed in an arena (not deleted by its parent)
+   */
+  void set_in_arena() { in_arena_ = true; }
+
+  /**
+   * \brief Check if node is placed in an arena
+   */
+  bool in_arena() const { return in_arena_; }
+
+  /**
+   * \brief Check if char can be stored in a node
+   * \param c Data
+   * \return true if char is a valid; false otherwise
+   */
+  static bool IsValidChar(char c) {
+    return Alphabet::kIndex[static_cast<unsigned char>(c)] != kNotInAlphabet;
+  }
+
+ private:
+  /**
+   * \brief Get index from char
+   * \param c Data (must be a valid char)
+   * \return Index
+   */
+  static uint32_t IndexFromChar(char c) {
+    assert(IsValidChar(c));
+    return Alphabet::kIndex[static_cast<unsigned char>(c)];
+  }
+
+  static constexpr uint32_t kMaxChildren =
+      Alphabet::kSize;  //!< Max number of children (letters)
+
+  // small members after the children, packed into one word
+  BasicNode *children_[kMaxChildren];  //!< Array of children nodes
+  uint16_t num_children_;              //!< Number of children of this node
+  char data_;                          //!< Data char stored
+  bool in_arena_;                      //!< Flag: node memory is an arena's
+  uint32_t words_;                     //!< Number of words ending here
+};
+
+enum class TreeRetCode { kOK, KCollision, kInvalidChar };
+
+/**
+ * \brief Walk sorted words with the chars each shares with the previous one
+ *
+ * In sorted order a word beginning another one is followed by words all
+ * beginning with it: every collision is between neighbours, when the shared
+ * chars are the whole previous word (same word included). Order and shared
+ * chars are those of the letters of Alphabet (SortWords<Alphabet>()), so
+ * chars of one letter are the same char.
+ *
+ * \param words Words sorted by SortWords<Alphabet>() (std::string_view
+ *        convertible)
+ * \param valid Function of a word: false to skip it (like kInvalidChar)
+ * \param fn Function of a word and its chars shared with the previous one
+ * \return KCollision if any; otherwise kInvalidChar if any word was skipped;
+ *         otherwise kOK
+ */
+template <typename Alphabet = AlphabetByte, typename Range, typename Valid,
+          typename Fn>
+inline TreeRetCode ForEachSortedWord(const Range &words, Valid &&valid,
+                                     Fn &&fn) {
+  const CpuKernels &k = cpu_kernels();
+  bool collision = false;
+  bool invalid = false;
+  bool first = true;
+  std::string_view prev;
+  for (const auto &w : words) {
+    const std::string_view word(w);
+    if (!valid(word)) {
+      invalid = true;
+      continue;
+    }
+    size_t common = 0;
+    if (!first) {
+      assert(!AlphabetLess<Alphabet>()(word, prev));
+      if constexpr (kAlphabetByteOrder<Alphabet>) {
+        common = k.common_prefix(prev.data(), word.data(),
+                                 std::min(prev.size(), word.size()));
+      } else {
+        common = AlphabetCommonPrefix<Alphabet>(prev, word);
+      }
+      if (common == prev.size()) {
+        collision = true;
+      }
+    }
+    fn(word, common);
+    prev = word;
+    first = false;
+  }
+
+  if (collision) {
+    return TreeRetCode::KCollision;
+  }
+
+  return invalid ? TreeRetCode::kInvalidChar : TreeRetCode::kOK;
+}
+
+/**
+ * \brief WordTree class
+ *
+ * Creates a tree where each letter of word is a node; words may only have
+ * letters of the Alphabet
+ */
+template <typename Alphabet>
+class BasicWordTree {
+ public:
+  using Node = BasicNode<Alphabet>;  //!< Node type
+  using Letters = Alphabet;          //!< Alphabet of words
+
+  /**
+   * \brief Default constructor
+   */
+  BasicWordTree() : root_('r') {}
+
+  /**
+   * \brief Add word to tree
+   *
+   * A collision is reported when the word begins with a word already in the
+   * tree, or a word already in the tree begins with it.
+   *
+   * \param word Word
+   * \return TreeRetCode; on kInvalidChar the tree is left untouched
+   */
+  TreeRetCode AddWord(std::string_view word);
+
+  /**
+   * \brief Replace the tree by the given words, in one pass
+   *
+   * Words are taken in sorted order, so each one only adds the nodes past the
+   * letters it shares with the previous word, with no child lookups. Nodes
+   * are counted first and placed in one arena, in depth first order. AddWord()
+   * may be used afterwards.
+   *
+   * \param words Words sorted by SortWords<Alphabet>() (letter order, so
+   *        chars of one letter sort together; std::string_view convertible)
+   * \return KCollision if any word begins another (same word included);
+   *         otherwise kInvalidChar if any word was skipped for invalid chars;
+   *         otherwise kOK
+   */
+  template <typename Range>
+  TreeRetCode BuildFromSorted(const Range &words);
+
+  /**
+   * \brief Move all words of another tree into this one
+   *
+   * Both trees are walked at once: subtrees only the other tree has are moved
+   * over as they are, and shared ones merged. A collision is where a word of
+   * one tree ends on a node of the other that is an end of word too, or has
+   * children (collisions within each tree are not looked for again).
+   * Subtrees of different first letters merge on different threads.
+   *
+   * \param other Tree to take words from (left empty)
+   * \param threads Number of threads (0 or 1 runs on the calling thread)
+   * \param conflicts If not nullptr, gets the colliding words (the word ending
+   *        where the other tree goes on), in order
+   * \return KCollision if words of the trees collide; kOK otherwise
+   */
+  TreeRetCode Merge(BasicWordTree &&other, unsigned threads = 1,
+                    std::vector<std::string> *conflicts = nullptr) {
+    const TreeRetCode ret = Walk(&root_, &other.root_, true, threads,
+                                 conflicts);
+    for (auto &arena : other.arenas_) {
+      arenas_.push_back(std::move(arena));
+    }
+    other.Clear();
+
+    return ret;
+  }
+
+  /**
+   * \brief Check words of this and another tree together, changing neither
+   *
+   * Same walk and collisions as Merge(), without moving anything.
+   *
+   * \param other Tree to check against
+   * \param threads Number of threads (0 or 1 runs on the calling thread)
+   * \param conflicts If not nullptr, gets the colliding words, in order
+   * \return KCollision if words of the trees collide; kOK otherwise
+   */
+  TreeRetCode CheckUnion(const BasicWordTree &other, unsigned threads = 1,
+                         std::vector<std::string> *conflicts = nullptr) const {
+    return Walk(const_cast<Node *>(&root_), const_cast<Node *>(&other.root_),
+                false, threads, conflicts);
+  }
+
+  /**
+   * \brief Remove a word from tree
+   *
+   * The word goes however many times it was added; nodes left with no word
+   * below them go too.
+   *
+   * \param word Word
+   * \return true if word was in tree; false otherwise
+   */
+  bool RemoveWord(std::string_view word);
+
+  /**
+   * \brief Check the whole tree for collisions
+   *
+   * Walks every node, for when collisions may be gone (after RemoveWord()).
+   *
+   * \return true if no word begins another (same word included); false
+   *         otherwise
+   */
+  bool IsConsistent() const;
+
+  /**
+   * \brief Call a function on every word in alphabet index order, once per
+   *        time it was added
+   * \param fn Function of a std::string_view (valid during the call)
+   */
+  template <typename Fn>
+  void ForEachWord(Fn &&fn) const {
+    std::string word;
+    ForEachWord(&root_, &word, fn);
+  }
+
+  /**
+   * \brief Remove all words from tree
+   */
+  void Clear() {
+    root_.Clear();
+    arenas_.clear();
+  }
+
+  /**
+   * \brief Check if all chars of a word are letters of the alphabet
+   */
+  static bool IsValidWord(std::string_view word) {
+    for (const char c : word) {
+      if (!Node::IsValidChar(c)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  /**
+   * \brief Add node to tree
+   * \param c Data
+   * \param base_node Base (parent) node
+   * \return Node added
+   */
+  Node *AddNode(char c, Node *base_node);
+
+  /**
+   * \brief Walk two trees at once from their roots (see Merge())
+   * \param a Root of this tree
+   * \param b Root of the other tree
+   * \param move Move nodes of b into a (otherwise nothing changes)
+   * \param threads Number of threads
+   * \param conflicts Colliding words; may be nullptr
+   * \return KCollision if any collision; kOK otherwise
+   */
+  static TreeRetCode Walk(Node *a, Node *b, bool move, unsigned threads,
+                          std::vector<std::string> *conflicts);
+
+  /**
+   * \brief Walk two nodes of the same prefix and their subtrees
+   * \param a Node of this tree
+   * \param b Node of the other tree
+   * \param move Move nodes of b into a
+   * \param prefix Chars down to a and b
+   * \param conflicts Colliding words; may be nullptr
+   * \return true if any collision; false otherwise
+   */
+  static bool WalkNodes(Node *a, Node *b, bool move, std::string *prefix,
+                        std::vector<std::string> *conflicts);
+
+  /**
+   * \brief Call fn on the words of a subtree
+   * \param node Subtree root
+   * \param word Chars down to node (restored on return)
+   * \param fn Function of a std::string_view
+   */
+  template <typename Fn>
+  static void ForEachWord(const Node *node, std::string *word, Fn &fn) {
+    for (uint32_t n = 0; n < node->words(); ++n) {
+      fn(std::string_view(*word));
+    }
+    for (uint32_t i = 0; i < Alphabet::kSize; ++i) {
+      const Node *child = node->child(i);
+      if (child != nullptr) {
+        word->push_back(child->data());
+        ForEachWord(child, word, fn);
+        word->pop_back();
+      }
+    }
+  }
+
+  using NodeStorage = std::aligned_storage_t<sizeof(Node), alignof(Node)>;
+
+  // arenas are declared first: root_ (holding arena nodes) goes first
+  std::vector<std::unique_ptr<NodeStorage[]>> arenas_;  //!< Bulk built nodes
+  Node root_;  //!< Root of word tree
+};
+
+template <typename Alphabet>
+inline typename BasicWordTree<Alphabet>::Node *BasicWordTree<Alphabet>::AddNode(
+    char c, Node *base_node) {
+  Node *node = base_node->GetChild(c);
+
+  if (node == nullptr) {
+    node = new Node(c);
+    base_node->AddChild(node);
+  }
+
+  return node;
+}
+
+template <typename Alphabet>
+inline TreeRetCode BasicWordTree<Alphabet>::AddWord(std::string_view word) {
+  if (!IsValidWord(word)) {
+    return TreeRetCode::kInvalidChar;
+  }
+
+  TreeRetCode ret = TreeRetCode::kOK;
+
+  Node *base_node = &root_;
+
+  // get letter by letter; passing by the end of another word is a collision
+  for (const char c : word) {
+    if (base_node->terminal()) {
+      ret = TreeRetCode::KCollision;
+    }
+
+    base_node = AddNode(c, base_node);
+  }
+
+  // same word again, or word is the beginning of another one
+  if (base_node->terminal() || base_node->num_children() > 0) {
+    ret = TreeRetCode::KCollision;
+  }
+  base_node->set_terminal();
+
+  return ret;
+}
+
+template <typename Alphabet>
+template <typename Range>
+inline TreeRetCode BasicWordTree<Alphabet>::BuildFromSorted(
+    const Range &words) {
+  Clear();
+
+  // nodes: chars past those shared with the previous word
+  size_t num_nodes = 0;
+  size_t max_length = 0;
+  ForEachSortedWord<Alphabet>(words, IsValidWord,
+                    [&](std::string_view word, size_t common) {
+                      num_nodes += word.size() - common;
+                      max_length = std::max(max_length, word.size());
+                    });
+  arenas_.emplace_back(new NodeStorage[num_nodes]);
+  NodeStorage *arena = arenas_.back().get();
+
+  // path[d]: node of the previous word at depth d
+  std::vector<Node *> path(max_length + 1, &root_);
+  size_t next = 0;
+
+  return ForEachSortedWord<Alphabet>(
+      words, IsValidWord, [&](std::string_view word, size_t common) {
+        for (size_t d = common; d < word.size(); ++d) {
+          Node *node = new (&arena[next++]) Node(word[d]);
+          node->set_in_arena();
+          path[d]->AddChild(node);
+          path[d + 1] = node;
+        }
+        path[word.size()]->set_terminal();
+      });
+}
+
+template <typename Alphabet>
+inline bool BasicWordTree<Alphabet>::RemoveWord(std::string_view word) {
+  if (!IsValidWord(word)) {
+    return false;
+  }
+
+  std::vector<Node *> path{&root_};
+  path.reserve(word.size() + 1);
+  for (const char c : word) {
+    Node *node = path.back()->GetChild(c);
+    if (node == nullptr) {
+      return false;
+    }
+    path.push_back(node);
+  }
+  if (!path.back()->terminal()) {
+    return false;
+  }
+  path.back()->unset_terminal();
+
+  // drop the nodes only this word went through, deepest first
+  for (size_t d = word.size(); d > 0; --d) {
+    Node *node = path[d];
+    if (node->terminal() || node->num_children() > 0) {
+      break;
+    }
+    path[d - 1]->ReleaseChild(
+        Alphabet::kIndex[static_cast<unsigned char>(word[d - 1])]);
+    if (!node->in_arena()) {
+      delete node;
+    }
+  }
+
+  return true;
+}
+
+template <typename Alphabet>
+inline bool BasicWordTree<Alphabet>::IsConsistent() const {
+  std::vector<const Node *> stack{&root_};
+  while (!stack.empty()) {
+    const Node *node = stack.back();
+    stack.pop_back();
+    if (node->words() > 1 || (node->terminal() && node->num_children() > 0)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < Alphabet::kSize; ++i) {
+      if (node->child(i) != nullptr) {
+        stack.push_back(node->child(i));
+      }
+    }
+  }
+
+  return true;
+}
+
+template <typename Alphabet>
+inline bool BasicWordTree<Alphabet>::WalkNodes(
+    Node *a, Node *b, bool move, std::string *prefix,
+    std::vector<std::string> *conflicts) {
+  // a word of one tree ends where the other has the same word or goes on
+  bool collision = (a->terminal() && (b->terminal() || b->num_children())) ||
+                   (b->terminal() && a->num_children());
+  if (collision && conflicts != nullptr) {
+    conflicts->push_back(*prefix);
+  }
+  if (move) {
+    a->add_words(b->words());
+  }
+
+  for (uint32_t i = 0; i < Alphabet::kSize; ++i) {
+    Node *b_child = b->child(i);
+    if (b_child == nullptr) {
+      continue;
+    }
+    Node *a_child = a->child(i);
+    if (a_child == nullptr) {
+      // nothing to meet on this side: subtree moves over as it is
+      if (move) {
+        a->AddChild(b->ReleaseChild(i));
+      }
+      continue;
+    }
+    prefix->push_back(b_child->data());
+    collision = WalkNodes(a_child, b_child, move, prefix, conflicts) ||
+                collision;
+    prefix->pop_back();
+  }
+
+  return collision;
+}
+
+template <typename Alphabet>
+inline TreeRetCode BasicWordTree<Alphabet>::Walk(
+    Node *a, Node *b, bool move, unsigned threads,
+    std::vector<std::string> *conflicts) {
+  // the roots alone: children are walked apart below
+  bool collision = (a->terminal() && (b->terminal() || b->num_children())) ||
+                   (b->terminal() && a->num_children());
+  if (collision && conflicts != nullptr) {
+    conflicts->push_back(std::string());
+  }
+  if (move) {
+    a->add_words(b->words());
+  }
+
+  // letters where both trees go on; the others need no walk
+  std::vector<uint32_t> shared;
+  for (uint32_t i = 0; i < Alphabet::kSize; ++i) {
+    if (b->child(i) == nullptr) {
+      continue;
+    }
+    if (a->child(i) != nullptr) {
+      shared.push_back(i);
+    } else if (move) {
+      a->AddChild(b->ReleaseChild(i));
+    }
+  }
+
+  // one subtree per task: tasks touch disjoint nodes
+  std::vector<std::vector<std::string>> found(shared.size());
+  std::vector<char> collided(shared.size(), 0);
+  std::atomic<size_t> next{0};
+  auto run = [&] {
+    std::string prefix;
+    for (size_t t = next++; t < shared.size(); t = next++) {
+      Node *a_child = a->child(shared[t]);
+      Node *b_child = b->child(shared[t]);
+      prefix.assign(1, b_child->data());
+      collided[t] = WalkNodes(a_child, b_child, move, &prefix,
+                              conflicts != nullptr ? &found[t] : nullptr);
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads && t < shared.size(); ++t) {
+    pool.emplace_back(run);
+  }
+  run();
+  for (std::thread &t : pool) {
+    t.join();
+  }
+
+  for (size_t t = 0; t < shared.size(); ++t) {
+    collision = collision || collided[t];
+    if (conflicts != nullptr) {
+      conflicts->insert(conflicts->end(), found[t].begin(), found[t].end());
+    }
+  }
+
+  return collision ? TreeRetCode::KCollision : TreeRetCode::kOK;
+}
+
+/**
+ * \brief Node of lowercase words
+ */
+using Node = BasicNode<AlphabetLower>;
+
+/**
+ * \brief Tree of lowercase words (the name book rule)
+ */
+using WordTree = BasicWordTree<AlphabetLower>;
+
+#endif  // WORD_TREE_H_
@@ -0,0 +1,156 @@
+/**
+ * \brief Cellcrypt word tree benchmark
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Times word tree engines on the same name sets: WordTree (a node per letter),
+ * NibbleTree (16 way nodes in a pool) and BurstTree (trie over sorted
+ * containers).
+ *
+ * Names are drawn from a vocabulary of random lowercase names with Zipf
+ * frequencies (name of rank r drawn in proportion to 1 / r^s; s = 0 is
+ * uniform), like real name lists where few names take most rows. Every engine
+ * adds the same names; time, heap in use after adding and collisions (the
+ * same for all) are printed per skew.
+ *
+ * Usage: word_tree_bench [n [vocabulary [s]]] (no s: s = 0, 0.8, 1, 1.2)
+ */
+
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "burst_tree.h"
+#include "nibble_tree.h"
+#include "word_tree.h"
+
+namespace {
+
+/**
+ * \brief Draw names with Zipf frequencies
+ * \param n Number of names
+ * \param vocabulary Distinct names to draw from
+ * \param s Zipf exponent
+ * \return Names
+ */
+std::vector<std::string> ZipfNames(size_t n, size_t vocabulary, double s) {
+  std::mt19937_64 rng(42);
+
+  std::vector<std::string> words(vocabulary);
+  std::uniform_int_distribution<int> length(5, 12);
+  std::uniform_int_distribution<int> letter('a', 'z');
+  for (std::string &w : words) {
+    w.resize(static_cast<size_t>(length(rng)));
+    for (char &c : w) {
+      c = static_cast<char>(letter(rng));
+    }
+  }
+
+  std::vector<double> cdf(vocabulary);
+  double total = 0;
+  for (size_t r = 0; r < vocabulary; ++r) {
+    total += 1.0 / std::pow(static_cast<double>(r + 1), s);
+    cdf[r] = total;
+  }
+
+  std::vector<std::string> names(n);
+  std::uniform_real_distribution<double> u(0, total);
+  for (std::string &name : names) {
+    const size_t r = static_cast<size_t>(
+        std::lower_bound(cdf.begin(), cdf.end(), u(rng)) - cdf.begin());
+    name = words[std::min(r, vocabulary - 1)];
+  }
+
+  return names;
+}
+
+/**
+ * \brief Heap bytes in use (mmapped blocks included)
+ */
+size_t HeapBytes() {
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+}
+
+/**
+ * \brief Print one engine row
+ * \param name Row name
+ * \param names Names to add
+ * \param collisions Collisions of the first engine; checked for the others
+ */
+template <typename Tree>
+void BenchTree(const char *name, const std::vector<std::string> &names,
+               size_t *collisions) {
+  double best = 0;
+  size_t heap = 0;
+  size_t count = 0;
+  for (int rep = 0; rep < 3; ++rep) {
+    const size_t before = HeapBytes();
+    const auto start = std::chrono::steady_clock::now();
+    {
+      Tree t;
+      count = 0;
+      for (const std::string &n : names) {
+        count += t.AddWord(n) == TreeRetCode::KCollision;
+      }
+      const std::chrono::duration<double, std::milli> ms =
+          std::chrono::steady_clock::now() - start;
+      heap = HeapBytes() - before;
+      if (rep == 0 || ms.count() < best) {
+        best = ms.count();
+      }
+    }
+  }
+
+  if (*collisions == SIZE_MAX) {
+    *collisions = count;
+  } else if (count != *collisions) {
+    std::cout << "Mismatch: " << name << " found " << count << " collisions"
+              << std::endl;
+  }
+  std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+            << std::setprecision(2) << std::setw(12) << best << std::setw(12)
+            << heap / 1024 << std::setw(12) << count << std::endl;
+}
+
+}  // namespace
+
+/**
+ * \brief Entry point of word tree benchmark
+ * \return 0 on success
+ */
+int main(int argc, char **argv) {
+  const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  const size_t vocabulary =
+      argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+  std::vector<double> skews{0, 0.8, 1, 1.2};
+  if (argc > 3) {
+    skews = {std::strtod(argv[3], nullptr)};
+  }
+
+  for (const double s : skews) {
+    const std::vector<std::string> names = ZipfNames(n, vocabulary, s);
+    std::cout << "names " << n << ", vocabulary " << vocabulary << ", s " << s
+              << std::endl;
+    std::cout << "engine        time (ms)   heap (KiB)  collisions"
+              << std::endl;
+
+    size_t collisions = SIZE_MAX;
+    BenchTree<WordTree>("WordTree", names, &collisions);
+    BenchTree<NibbleTree>("NibbleTree", names, &collisions);
+    BenchTree<BurstTree>("BurstTree", names, &collisions);
+  }
+
+  return 0;
+}
@@ -0,0 +1,324 @@
+/**
+ * \brief Cellcrypt word tree test
+ *
+ * Copyright Felipe Bolsi
+ */
+
+/**
+ * Checks bulk builds against adding the same words one by one (AddWord()),
+ * for lowercase words (AlphabetLower) and case folded ones
+ * (AlphabetAlnumFold, where 'A' and 'a' are one letter):
+ *
+ * - build: BuildFromSorted() of words sorted by SortWords() gives the return
+ *   code, words and consistency that AddWord() gives;
+ * - bulk: a bulk ReadNamesFrom() into a book that has names already gives the
+ *   consistency and names of reading them one by one;
+ * - batch: CheckBatch() of words against a book answers as adding them all
+ *   to a copy of the book would, and changes nothing;
+ * - burst: BasicBurstTree::AddWord() returns what BasicWordTree::AddWord()
+ *   does, word by word, with enough words for containers to burst.
+ *
+ * Words are random and short, over few letters (and both cases when folded),
+ * so prefixes and same words of different case are common.
+ *
+ * Usage: word_tree_test [rounds [seed]]
+ * \return 0 if every check passed; 1 otherwise
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "burst_tree.h"
+#include "name_book_tree.h"
+#include "word_tree.h"
+
+namespace {
+
+using FoldTree = BasicWordTree<AlphabetAlnumFold>;  //!< Case folded words
+
+int g_failures = 0;  //!< Checks failed so far
+
+/**
+ * \brief Count and report a failed check
+ */
+void Check(bool ok, const char *what) {
+  if (!ok) {
+    ++g_failures;
+    std::cerr << "FAILED: " << what << std::endl;
+  }
+}
+
+/**
+ * \brief Word in letter indices (same for words of the same letters)
+ */
+template <typename Alphabet>
+std::string Letters(std::string_view word) {
+  std::string letters;
+  for (const char c : word) {
+    letters.push_back(static_cast<char>(
+        Alphabet::kIndex[static_cast<unsigned char>(c)]));
+  }
+
+  return letters;
+}
+
+/**
+ * \brief Count words of a tree or book by their letters
+ */
+template <typename Alphabet, typename T>
+std::map<std::string, size_t> CountWords(const T &t) {
+  std::map<std::string, size_t> counts;
+  auto count = [&](std::string_view word) {
+    ++counts[Letters<Alphabet>(word)];
+  };
+  if constexpr (std::is_same_v<T, BasicWordTree<Alphabet>>) {
+    t.ForEachWord(count);
+  } else {
+    t.ForEachName(count);
+  }
+
+  return counts;
+}
+
+/**
+ * \brief Draw short words over a few letters; folded words get both cases,
+ *        and now and then a char out of the alphabet
+ */
+template <typename Alphabet>
+std::vector<std::string> RandomWords(std::mt19937_64 *rng) {
+  constexpr bool kFold = std::is_same_v<Alphabet, AlphabetAlnumFold>;
+  std::vector<std::string> words((*rng)() % 12);
+  for (std::string &w : words) {
+    w.resize((*rng)() % 4);
+    for (char &c : w) {
+      c = static_cast<char>(((*rng)() % 2 == 0 && kFold ? 'A' : 'a') +
+                            (*rng)() % 3);
+      if ((*rng)() % 64 == 0) {
+        c = '-';
+      }
+    }
+  }
+
+  return words;
+}
+
+/**
+ * \brief Reader of names from a vector (ReadNamesFrom() interface)
+ */
+class VectorReader {
+ public:
+  explicit VectorReader(const std::vector<std::string> &names)
+      : names_(names), next_(0) {}
+
+  bool Next(std::string_view *name) {
+    if (next_ == names_.size()) {
+      return false;
+    }
+    *name = names_[next_++];
+    return true;
+  }
+
+  bool failed() const { return false; }
+
+ private:
+  const std::vector<std::string> &names_;  //!< Names
+  size_t next_;                            //!< Next name
+};
+
+/**
+ * \brief BuildFromSorted() against AddWord() of the same words
+ */
+template <typename Alphabet>
+void TestBuild(const std::vector<std::string> &words, const char *what) {
+  using Tree = BasicWordTree<Alphabet>;
+
+  Tree one_by_one;
+  bool collision = false;
+  bool invalid = false;
+  for (const std::string &w : words) {
+    const TreeRetCode ret = one_by_one.AddWord(w);
+    collision = collision || ret == TreeRetCode::KCollision;
+    invalid = invalid || ret == TreeRetCode::kInvalidChar;
+  }
+  const TreeRetCode expected = collision ? TreeRetCode::KCollision
+                               : invalid ? TreeRetCode::kInvalidChar
+                                         : TreeRetCode::kOK;
+
+  std::vector<std::string_view> sorted(words.begin(), words.end());
+  SortWords<Alphabet>(&sorted);
+  Tree bulk;
+  Check(bulk.BuildFromSorted(sorted) == expected, what);
+  Check(CountWords<Alphabet>(bulk) == CountWords<Alphabet>(one_by_one), what);
+  Check(bulk.IsConsistent() == one_by_one.IsConsistent(), what);
+}
+
+/**
+ * \brief Bulk ReadNamesFrom() on top of names already in a book
+ */
+template <typename Alphabet>
+void TestBulk(const std::vector<std::string> &book_words,
+              const std::vector<std::string> &words, const char *what) {
+  using Book = BasicNameBookTree<BasicWordTree<Alphabet>>;
+
+  Book one_by_one;
+  Book bulk;
+  for (const std::string &w : book_words) {
+    one_by_one.AddName(w);
+    bulk.AddName(w);
+  }
+  VectorReader one_reader(words);
+  one_by_one.ReadNamesFrom(&one_reader);
+  VectorReader bulk_reader(words);
+  bulk.ReadNamesFrom(&bulk_reader, true);
+
+  Check(bulk.consistent() == one_by_one.consistent(), what);
+  Check(CountWords<Alphabet>(bulk) == CountWords<Alphabet>(one_by_one), what);
+}
+
+/**
+ * \brief CheckBatch() against adding the batch to a book one by one
+ */
+template <typename Alphabet>
+void TestBatch(const std::vector<std::string> &book_words,
+               const std::vector<std::string> &words, const char *what) {
+  using Book = BasicNameBookTree<BasicWordTree<Alphabet>>;
+
+  Book book;
+  Book added;
+  for (const std::string &w : book_words) {
+    book.AddName(w);
+    added.AddName(w);
+  }
+  // a batch only answers for itself: the book must be consistent alone
+  if (!book.consistent()) {
+    return;
+  }
+  for (const std::string &w : words) {
+    added.AddName(w);
+  }
+
+  const auto before = CountWords<Alphabet>(book);
+  std::vector<std::string> conflicts;
+  Check(book.CheckBatch(words, &conflicts) == added.consistent(), what);
+  Check(conflicts.empty() == added.consistent(), what);
+  Check(CountWords<Alphabet>(book) == before, what);
+}
+
+/**
+ * \brief BasicBurstTree::AddWord() against BasicWordTree::AddWord()
+ */
+template <typename Alphabet>
+void TestBurst(const std::vector<std::string> &words, const char *what) {
+  BasicWordTree<Alphabet> tree;
+  BasicBurstTree<Alphabet> burst;
+  for (const std::string &w : words) {
+    Check(burst.AddWord(w) == tree.AddWord(w), what);
+  }
+}
+
+/**
+ * \brief Many longer words, so containers burst
+ */
+template <typename Alphabet>
+std::vector<std::string> RandomBurstWords(std::mt19937_64 *rng) {
+  std::vector<std::string> words;
+  while (words.size() < 4 * kBurstEntries) {
+    for (const std::string &w : RandomWords<Alphabet>(rng)) {
+      words.push_back(w + w + w);
+    }
+  }
+
+  return words;
+}
+
+/**
+ * \brief Random words on both alphabets
+ */
+void TestRandom(uint32_t rounds, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  for (uint32_t round = 0; round < rounds; ++round) {
+    const auto lower = RandomWords<AlphabetLower>(&rng);
+    TestBuild<AlphabetLower>(lower, "lower: build");
+    TestBulk<AlphabetLower>(RandomWords<AlphabetLower>(&rng), lower,
+                            "lower: bulk");
+    TestBatch<AlphabetLower>(RandomWords<AlphabetLower>(&rng), lower,
+                             "lower: batch");
+
+    const auto fold = RandomWords<AlphabetAlnumFold>(&rng);
+    TestBuild<AlphabetAlnumFold>(fold, "fold: build");
+    TestBulk<AlphabetAlnumFold>(RandomWords<AlphabetAlnumFold>(&rng), fold,
+                                "fold: bulk");
+    TestBatch<AlphabetAlnumFold>(RandomWords<AlphabetAlnumFold>(&rng), fold,
+                                 "fold: batch");
+
+    if (round % 64 == 0) {
+      TestBurst<AlphabetLower>(RandomBurstWords<AlphabetLower>(&rng),
+                               "lower: burst");
+      TestBurst<AlphabetAlnumFold>(RandomBurstWords<AlphabetAlnumFold>(&rng),
+                                   "fold: burst");
+    }
+  }
+}
+
+/**
+ * \brief Known cases
+ */
+void TestCases() {
+  TestBuild<AlphabetLower>({"ab", "b", "abc"}, "lower: ab begins abc");
+  TestBuild<AlphabetLower>({"ab", "ba", "c"}, "lower: no collision");
+
+  // "Ab" sorts apart from "abc" byte by byte, but begins it
+  std::vector<std::string_view> sorted{"Ab", "B", "abc"};
+  SortWords<AlphabetAlnumFold>(&sorted);
+  FoldTree tree;
+  Check(tree.BuildFromSorted(sorted) == TreeRetCode::KCollision,
+        "fold: Ab begins abc");
+  Check(!tree.IsConsistent(), "fold: Ab begins abc, consistency");
+  TestBuild<AlphabetAlnumFold>({"Ab", "B", "abc"}, "fold: Ab begins abc");
+  TestBuild<AlphabetAlnumFold>({"ab", "AB"}, "fold: same word");
+  TestBuild<AlphabetAlnumFold>({"Ab", "aC", "B"}, "fold: no collision");
+  TestBulk<AlphabetAlnumFold>({"b"}, {"Ab", "B", "abc"}, "fold: bulk");
+
+  BasicNameBookTree<FoldTree> book;
+  Check(!book.CheckBatch(std::vector<std::string>{"ab", "AB"}),
+        "fold: batch of one word in two cases");
+  TestBatch<AlphabetLower>({"cd"}, {"ab", "b", "abc"}, "lower: batch");
+  TestBatch<AlphabetAlnumFold>({"cd"}, {"ab", "AB"}, "fold: batch");
+  TestBatch<AlphabetAlnumFold>({"cd"}, {"Ab", "B", "abc"}, "fold: batch");
+  TestBatch<AlphabetAlnumFold>({"AB"}, {"abc"}, "fold: batch and book");
+
+  TestBurst<AlphabetAlnumFold>({"ab", "AB"}, "fold: burst, same word");
+  // "Ac" is less than "ab" byte by byte: in one container below 'x', then a
+  // burst
+  std::vector<std::string> burst{"xAc", "xab"};
+  for (size_t i = 0; burst.size() <= kBurstEntries; ++i) {
+    burst.push_back("x" + std::string(1, static_cast<char>('d' + i % 20)) +
+                    std::to_string(i));
+  }
+  burst.push_back("XAB");
+  burst.push_back("xaCy");
+  TestBurst<AlphabetAlnumFold>(burst, "fold: burst of Ac and ab");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  const uint32_t rounds =
+      argc > 1 ? static_cast<uint32_t>(std::strtoul(argv[1], nullptr, 10))
+               : 2000;
+  const uint64_t seed = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1;
+
+  TestCases();
+  TestRandom(rounds, seed);
+
+  std::cout << (g_failures == 0 ? "ok" : "FAILED") << std::endl;
+
+  return g_failures == 0 ? 0 : 1;
+}